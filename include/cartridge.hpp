@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Description of a cartridge, parsed from its header (0x0100-0x014F) when the ROM is loaded.
+ */
+struct CartridgeInfo {
+    std::string title; /**< Game title, in upper case ASCII. */
+    uint8_t cgb_flag {}; /**< CGB flag (0x143): 0x80 if the game supports the CGB, 0xc0 if it requires it. */
+    uint8_t type {}; /**< Cartridge type (0x147), i.e., the memory bank controller and extra hardware. */
+    size_t rom_size {}; /**< ROM size in bytes, as declared by the header (0x148). */
+    size_t ram_size {}; /**< Cartridge RAM size in bytes (0x149), 0 if there is none. */
+    bool has_battery {}; /**< true if the cartridge RAM keeps its content when powered off. */
+    uint8_t header_checksum {}; /**< Checksum of the header bytes 0x134-0x14C, as stored at 0x14D. */
+    bool header_checksum_valid {}; /**< true if the stored header checksum matches the header. */
+    uint16_t global_checksum {}; /**< Sum of all the ROM bytes, as stored at 0x14E-0x14F. */
+    bool global_checksum_valid {}; /**< true if the stored global checksum matches the ROM. */
+    uint32_t hash {}; /**< CRC32C of the whole ROM image, identifying the game in the per-ROM caches. */
+};
+
+/**
+ * @brief Parses the header of a ROM image and fingerprints its content.
+ *
+ * @param rom The whole ROM image.
+ * @return The cartridge description. Images too small to hold a header get an empty description with their hash.
+ */
+CartridgeInfo parse_cartridge(const std::vector<uint8_t>& rom);
+
+/**
+ * @brief Gives a ROM image shared by all the instances that loaded the same game.
+ *
+ * Images are looked up by hash, then compared byte by byte, so that the instances running the same game keep a single
+ * copy of it. The cache only holds weak references: an image is freed along with its last user.
+ *
+ * @param image The loaded ROM image, dropped if an identical one is already in use.
+ * @param hash CRC32C of the image, see CartridgeInfo::hash.
+ * @return The shared image.
+ */
+std::shared_ptr<const std::vector<uint8_t>> share_rom(std::vector<uint8_t>&& image, uint32_t hash);
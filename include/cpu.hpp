@@ -2,9 +2,9 @@
 
 #include "memory.hpp"
 #include "registers.hpp"
+#include <array>
 #include <cstdint>
 #include <functional>
-#include <unordered_map>
 
 /**
  * @brief Retrieves the Most Significant Byte of a 2-bytes word.
@@ -53,6 +53,15 @@ public:
      * @brief Makes a fetch->decode->execute cycle.
      */
     void cycle();
+    /**
+     * @brief Gives the memory shared by all the CPU instances.
+     *
+     * The heap the std::function entries may own, for the captures too large for their inline storage, cannot be
+     * measured and is not counted.
+     *
+     * @return The size in bytes of the instruction tables, their std::function entries and cycle counts.
+     */
+    static size_t shared_bytes() { return sizeof(InstructionTables); }
 
 private:
     Memory& memory; /**< Reference to the Game Boy memory. */
@@ -60,14 +69,24 @@ private:
     uint16_t opcode {}; /**< Current operation code read from the memory. */
     uint8_t cycles_left {}; /**< Number of cycles left for the previous instruction. */
     uint64_t total_cycles {}; /** < Total number of elapsed cycles. */
-    /**< Maps standard opcodes (0x00–0xFF) to their instructions */
-    std::unordered_map<uint8_t, std::function<void()>> opcode_table {};
-    /**< Maps CB-prefixed opcodes (0xCB00–0xCBFF) to their instructions */
-    std::unordered_map<uint8_t, std::function<void()>> cbcode_table {};
-    /**< Maps an operation code to its corresponding number of cycles. */
-    std::unordered_map<uint8_t, uint8_t> instruction_cycles {};
-    /**< Maps a CB-prefixed operation code to its corresponding number of cycles. */
-    std::unordered_map<uint8_t, uint8_t> cb_instruction_cycles {};
+    /**
+     * @brief Instruction tables, built once and shared by all the CPU instances.
+     */
+    struct InstructionTables {
+        /**< Maps standard opcodes (0x00–0xFF) to their instructions, empty for the unused opcodes. */
+        std::array<std::function<void(CPU&)>, 0x100> opcode_table {};
+        /**< Maps CB-prefixed opcodes (0xCB00–0xCBFF) to their instructions */
+        std::array<std::function<void(CPU&)>, 0x100> cbcode_table {};
+        /**< Maps an operation code to its corresponding number of cycles. */
+        std::array<uint8_t, 0x100> instruction_cycles {};
+        /**< Maps a CB-prefixed operation code to its corresponding number of cycles. */
+        std::array<uint8_t, 0x100> cb_instruction_cycles {};
+    };
+    using Reg8Getter = uint8_t& (*)(CPU&); /**< Retrieves an 8-bit register of a CPU by reference. */
+
+    /**< Retrieves the 8-bit registers in the order of the opcode operand encoding (B, C, D, E, H, L, (HL), A). */
+    static const std::array<Reg8Getter, 8> reg8_getters;
+    const InstructionTables& tables; /**< Instruction tables shared by all the instances. */
 
     bool stopped { false }; /**< true if the CPU has been stopped by the STOP instructions. */
     bool halted { false }; /**< true if the CPU has been halted by the HALT instructions. */
@@ -93,52 +112,60 @@ private:
      * @brief Outputs the content of the serial output in the console.
      */
     void check_serial_output();
+    /**
+     * @brief Gives the instruction tables, building them on the first call.
+     *
+     * @return The tables shared by all the CPU instances.
+     */
+    static const InstructionTables& shared_tables();
     /**
      * @brief Sets up the operatieon code table and the instruction cycles table to map an instruction to the correct
      * method and the number of cycles.
+     *
+     * @return The filled tables.
      */
-    void setup_tables();
+    static InstructionTables setup_tables();
     /**
      * @brief Used to efficiently register the 8-bit registers manipulation operations.
      *
      * The operations registered with it are ADD, ADC, SUB, SBC, AND, XOR, OR, CP.
      *
+     * @param tables The tables to register the operations into.
      * @param start_code The start code of the instruction group.
-     * @param reg8_getters The function used to retrieve the 8-bit register by reference.
-     * @param fn The function to call on the register.
+     * @param fn The function to call on the register value, or on the memory byte located at the address HL.
      */
-    void register_reg8_manip_group(uint8_t start_code,
-        const std::array<std::function<uint8_t&()>, 8>& reg8_getters,
-        std::function<void(uint8_t&)> fn);
+    static void register_reg8_manip_group(InstructionTables& tables,
+        uint8_t start_code,
+        std::function<void(CPU&, uint8_t)> fn);
     /**
      * @brief Used to efficiently register the first section of the 0xCB operations.
      *
      * The operations registered with it are RLC, RRC, RL, RR, SLA, SRA, SWAP, SRL.
      *
+     * @param tables The tables to register the operations into.
      * @param start_code The start code of the instruction group.
-     * @param reg8_getters The function used to retrieve the 8-bit register by reference.
      * @param reg8_fn The function to call on the 8-bit registers.
      * @param hl_fn The function to call on the memory byte located at the address HL.
      */
-    void register_cb_group(uint8_t start_code,
-        const std::array<std::function<uint8_t&()>, 8>& reg8_getters,
-        std::function<void(uint8_t&)> reg8_fn,
-        std::function<void()> hl_fn);
+    static void register_cb_group(InstructionTables& tables,
+        uint8_t start_code,
+        std::function<void(CPU&, uint8_t&)> reg8_fn,
+        std::function<void(CPU&)> hl_fn);
     /**
      * @brief Used to efficiently register the second section of the 0xCB operations.
      *
      * The operations registered with it are BIT, RES, SET.
      *
+     * @param tables The tables to register the operations into.
      * @param start_code The start code of the instruction group.
-     * @param reg8_getters The function used to retrieve the 8-bit register by reference.
      * @param reg8_fn The function to call on the 8-bit registers.
      * @param hl_fn The function to call on the memory byte located at the address HL.
      */
     template <typename Reg8Fn>
-    void register_cb_group_large(uint8_t start_code,
-        const std::array<std::function<uint8_t&()>, 8>& reg8_getters,
+    static void register_cb_group_large(InstructionTables& tables,
+        uint8_t start_code,
         Reg8Fn reg8_fn,
-        std::function<void(const uint8_t)> hl_fn);
+        std::function<void(CPU&, const uint8_t)> hl_fn);
     /**
      * @brief Fetches the next byte from memory pointed by the program counter (PC) and increments PC.
      *
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "graphics.hpp"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Records the frames to a file, from a writer thread, so that the emulation thread never waits on the disk.
+ *
+ * The emulation thread copies each frame into a bounded queue, and a writer thread converts the queued frames to
+ * 8-bit gray and writes them in large batches. When the queue is full, the frame is dropped and counted instead.
+ *
+ * Two file formats are written:
+ * - Y4M (.y4m extension), a YUV4MPEG2 stream with a single gray plane that video tools read as is.
+ * - raw gray frames of 160x144 bytes back to back, with an index next to them (same path with .idx appended). The
+ *   index is a text file giving for each recorded frame its emulated frame number and its offset in the raw file,
+ *   so that the dropped frames can be told apart.
+ */
+class FrameRecorder {
+public:
+    static constexpr uint32_t CAPACITY = 64; /**< Number of frames the queue holds, a power of 2. */
+    static constexpr uint32_t BATCH_FRAMES = 16; /**< Number of frames written to the file at once. */
+
+    /**
+     * @brief File formats.
+     */
+    enum class Format : uint8_t {
+        Y4m, /**< YUV4MPEG2 stream, gray. */
+        Raw, /**< Raw gray frames, with an index. */
+    };
+
+    /**
+     * @brief Creates the files and starts the writer thread.
+     *
+     * @param path Path of the recording. The format is Y4M if it ends with .y4m, raw otherwise.
+     * @throws std::runtime_error if a file could not be created.
+     */
+    FrameRecorder(const std::string& path);
+    /**
+     * @brief Closes the recording, see close().
+     */
+    ~FrameRecorder();
+
+    FrameRecorder(const FrameRecorder&) = delete;
+    FrameRecorder& operator=(const FrameRecorder&) = delete;
+
+    /**
+     * @brief Queues a frame, or drops it if the queue is full. Called by the emulation thread after each frame.
+     *
+     * @param pixels The frame, PPU::SCREEN_HEIGHT rows of PPU::SCREEN_WIDTH pixels.
+     * @param pixel_format Format of the pixels.
+     * @param stride Distance between the starts of two rows, in bytes.
+     * @param frame Emulated frame number, written to the index of the raw format.
+     * @return true if the frame was queued, false if it was dropped.
+     */
+    bool push(const uint8_t* pixels, PixelFormat pixel_format, size_t stride, uint64_t frame);
+    /**
+     * @brief Writes the frames left in the queue, stops the writer thread and closes the files. The frames pushed
+     * afterwards are dropped.
+     */
+    void close();
+    /**
+     * @brief Gives the number of frames dropped, because the queue was full or the file could not be written.
+     *
+     * @return The dropped frame count.
+     */
+    uint64_t dropped_frames() const { return dropped.load(std::memory_order_relaxed); }
+    /**
+     * @brief Gives the number of frames written to the file so far.
+     *
+     * @return The written frame count.
+     */
+    uint64_t written_frames() const { return written.load(std::memory_order_relaxed); }
+    /**
+     * @brief Tells if writing to the file failed. The frames are then dropped.
+     *
+     * @return true after a write error.
+     */
+    bool failed() const { return write_failed.load(std::memory_order_relaxed); }
+
+private:
+    /**
+     * @brief Description of a queued frame.
+     */
+    struct Slot {
+        uint64_t frame; /**< Emulated frame number. */
+        PixelFormat format; /**< Format of the pixels. */
+    };
+
+    Format format; /**< Format of the file. */
+    int fd { -1 }; /**< File the frames are written to. */
+    int index_fd { -1 }; /**< Index of the raw format, -1 for Y4M. */
+    std::vector<uint8_t> frames; /**< Pixels of the queued frames, each one in a slot large enough for any format. */
+    std::array<Slot, CAPACITY> slots {}; /**< Description of the queued frames. */
+    alignas(64) std::atomic<uint32_t> tail {}; /**< Number of frames queued, written by the emulation thread. */
+    alignas(64) std::atomic<uint32_t> head {}; /**< Number of frames taken by the writer thread. */
+    std::atomic<uint32_t> wakeups {}; /**< Changed to wake the writer thread up. */
+    std::atomic<bool> closing { false }; /**< true once the writer thread has to stop. */
+    std::atomic<uint64_t> dropped {}; /**< Number of dropped frames. */
+    std::atomic<uint64_t> written {}; /**< Number of frames written. */
+    std::atomic<bool> write_failed { false }; /**< true after a write error. */
+    std::thread writer; /**< The writer thread. */
+
+    /**
+     * @brief Body of the writer thread, converting and writing the queued frames in batches.
+     */
+    void write_loop();
+    /**
+     * @brief Writes a buffer to a file, retrying on partial writes.
+     *
+     * @param file File descriptor.
+     * @param data Bytes to write.
+     * @return false on error.
+     */
+    static bool write_all(int file, const std::string& data);
+};
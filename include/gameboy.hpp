@@ -2,7 +2,13 @@
 
 #include "cpu.hpp"
 #include "memory.hpp"
+#include "observations.hpp"
 #include "ppu.hpp"
+#include "scheduler.hpp"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
 #include <string>
 
 /**
@@ -10,6 +16,22 @@
  */
 class GameBoy {
 public:
+    static constexpr uint64_t CYCLES_PER_SECOND = 4194304; /**< System clock rate. */
+    static constexpr uint64_t CYCLES_PER_FRAME = 70224; /**< Duration of a frame: 154 lines of 456 cycles. */
+
+    /**
+     * @brief Memory used by an emulator instance.
+     */
+    struct Footprint {
+        size_t object_bytes; /**< Size of the GameBoy object itself, i.e., the machine state. */
+        /**
+         * Memory owned by the instance outside of the object: cartridge RAM, caches of the drawing, render thread,
+         * observations and bookkeeping.
+         */
+        size_t heap_bytes;
+        size_t shared_bytes; /**< Memory shared with the other instances: ROM image and instruction tables. */
+    };
+
     /**
      * @brief Game Boy class constructor.
      */
@@ -21,12 +43,155 @@ public:
      */
     void load_rom(const std::string& filename);
     /**
-     * @brief Starts the program previously loaded into memory.
+     * @brief Gives the description of the loaded cartridge.
+     *
+     * @return The header fields and content hash of the ROM.
+     */
+    const CartridgeInfo& cartridge_info() const;
+    /**
+     * @brief Sets the delay between two background flushes of the battery-backed save to the disk.
+     *
+     * @param interval New delay. Zero disables periodic flushing, the save is then only written on exit.
+     */
+    void set_save_flush_interval(std::chrono::milliseconds interval);
+#ifdef GAMEBOY_WATCHPOINTS
+    /**
+     * @brief Watches accesses to an address range. See Memory::add_watchpoint().
+     *
+     * @param first First watched address.
+     * @param last Last watched address (included).
+     * @param kinds Combination of Memory::WATCH_READ, Memory::WATCH_WRITE and Memory::WATCH_EXECUTE.
+     * @param callback Function called on each watched access, returning true to break. Without one, every access
+     * breaks.
+     * @return Identifier of the watchpoint, used to remove it.
+     */
+    int add_watchpoint(uint16_t first, uint16_t last, uint8_t kinds, Memory::WatchCallback callback = {});
+    /**
+     * @brief Removes a watchpoint. See Memory::remove_watchpoint().
+     *
+     * @param id Identifier given by add_watchpoint().
+     */
+    void remove_watchpoint(int id);
+#endif
+#ifdef GAMEBOY_HEATMAP
+    /**
+     * @brief Writes the memory access heatmap as CSV. See Memory::export_heatmap().
+     *
+     * @param path Path of the CSV file.
+     */
+    void export_heatmap(const std::string& path) const;
+#endif
+    /**
+     * @brief Starts the program previously loaded into memory. Returns once stop() has been called, or when a
+     * watchpoint breaks.
+     *
+     * @param frame_done Function called after each frame, e.g. to read the framebuffer.
+     */
+    void run(const std::function<void()>& frame_done = {});
+    /**
+     * @brief Runs the emulation until the end of the current frame, i.e., until the PPU enters VBlank. While the LCD
+     * is off, runs for the duration of a frame instead.
+     *
+     * @return false if a watchpoint broke before the end of the frame, true otherwise.
+     */
+    bool run_frame();
+    /**
+     * @brief Asks the running emulation to return from run(). Safe to call from a signal handler.
+     */
+    void stop();
+    /**
+     * @brief Selects the PPU renderer, from the next frame on. See PPU::Renderer.
+     *
+     * @param renderer The scanline renderer for speed, or the pixel FIFO one for accuracy.
+     */
+    void set_renderer(PPU::Renderer renderer);
+    /**
+     * @brief Enables or disables the drawing of the frames, without changing the emulation. See
+     * PPU::set_render_skip().
+     *
+     * @param skip true to leave the framebuffer untouched, except for the frames asked for with render_next_frames().
+     */
+    void set_render_skip(bool skip);
+    /**
+     * @brief Draws the next frames even if render skipping is enabled. See PPU::render_next_frames().
+     *
+     * @param count Number of frames to draw. The frame returned by the next run_frame() call is the first one.
      */
-    void run();
+    void render_next_frames(uint32_t count);
+    /**
+     * @brief Moves the drawing to a render thread, or back to the emulation thread. See PPU::set_render_thread().
+     *
+     * @param enabled true to draw the frames of the scanline renderer on a render thread.
+     */
+    void set_render_thread(bool enabled);
+    /**
+     * @brief Draws the frames into a buffer of the embedder. See PPU::set_output().
+     *
+     * @param pixels Buffer of PPU::SCREEN_HEIGHT rows, or nullptr to use the internal framebuffer again.
+     * @param format Format of the pixels.
+     * @param stride Distance between the starts of two rows, in bytes.
+     * @throws std::runtime_error if the stride is smaller than a row.
+     */
+    void set_frame_output(uint8_t* pixels, PixelFormat format, size_t stride);
+    /**
+     * @brief Gives the screen content, when no output buffer is set.
+     *
+     * @return The last rendered frame, one shade (0 = white to 3 = black) per pixel. White while an output buffer is
+     * set.
+     */
+    const PPU::Framebuffer& framebuffer() const;
+    /**
+     * @brief Gives the hash of the last drawn frame. See PPU::frame_hash().
+     *
+     * @return The CRC32C of the shades of the frame.
+     */
+    uint32_t frame_hash() const;
+    /**
+     * @brief Tells if the last drawn frame is the same as the one before, so that it can be skipped.
+     *
+     * @return true if both frames have the same hash.
+     */
+    bool frame_repeated() const;
+    /**
+     * @brief Starts taking downscaled gray observations of the frames, from the next frame on. See Observations.
+     *
+     * The PPU then also draws each frame in gray, the observations being taken at the end of the frames by
+     * run_frame(). Replaces the observations taken so far.
+     *
+     * @param config Size, history, period and pooling of the observations.
+     * @throws std::runtime_error if the settings are invalid.
+     */
+    void enable_observations(const Observations::Config& config);
+    /**
+     * @brief Stops taking observations and frees them.
+     */
+    void disable_observations();
+    /**
+     * @brief Gives the observations, to be read between two frames.
+     *
+     * @return The observations, nullptr if not enabled.
+     */
+    const Observations* observations() const { return observation_buffer.get(); }
+    /**
+     * @brief Gives the memory used by this instance, to budget how many of them fit on a host.
+     *
+     * The caches of the drawing are allocated by the first drawn frame, an instance is measured once it ran a frame.
+     *
+     * @return The object, owned and shared sizes.
+     */
+    Footprint footprint() const;
+    /**
+     * @brief Gives the pages written since the last call and marks them as clean. See Memory::take_dirty_pages().
+     *
+     * @return The dirty page bitmap.
+     */
+    PageBitmap take_dirty_pages();
 
 private:
-    CPU cpu; /**< Game Boy CPU handling the execution of the operation codes read from the ROM memory. */
+    Scheduler scheduler; /**< System clock, running the events scheduled by the components. */
     Memory memory; /**< Game Boy memory, with the loaded ROM, RAM and so on. */
+    CPU cpu; /**< Game Boy CPU handling the execution of the operation codes read from the ROM memory. */
     PPU ppu; /**< Pixel Processing Unit, the display of the console. */
+    std::atomic<bool> running { false }; /**< false once the emulation has been asked to stop. */
+    std::unique_ptr<Observations> observation_buffer; /**< Observations taken after each frame, if enabled. */
 };
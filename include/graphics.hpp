@@ -0,0 +1,109 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Table mapping the color codes of a line to shades, see map_palettes().
+ *
+ * Codes 0-3 are background colors mapped through BGP, 4-7 object colors through OBP0 and 8-11 object colors through
+ * OBP1.
+ */
+using PaletteTable = std::array<uint8_t, 16>;
+
+/**
+ * @brief Palette table leaving the codes 0-3 unchanged, for lines already holding shades.
+ */
+inline constexpr PaletteTable shade_palette_table = { 0, 1, 2, 3 };
+
+/**
+ * @brief Pixel formats of the frames given to the embedder.
+ */
+enum class PixelFormat : uint8_t {
+    Shade2, /**< One byte per pixel holding the shade, from 0 = white to 3 = black. */
+    Gray8, /**< One byte per pixel, from 0xff = white to 0x00 = black. */
+    Rgb565, /**< One little-endian 16-bit word per pixel: 5 bits of red, 6 of green and 5 of blue. */
+    Rgba8888, /**< Four bytes per pixel: red, green, blue and alpha, the alpha being always 0xff. */
+};
+
+/**
+ * @brief Gives the size of a pixel in a given format.
+ *
+ * @param format The pixel format.
+ * @return The number of bytes of a pixel.
+ */
+constexpr size_t bytes_per_pixel(PixelFormat format)
+{
+    switch (format) {
+    case PixelFormat::Rgb565:
+        return 2;
+    case PixelFormat::Rgba8888:
+        return 4;
+    default:
+        return 1;
+    }
+}
+
+/**
+ * @brief Table mapping the color codes of a line to output pixels, see write_pixels().
+ *
+ * Each entry holds the bytes of a pixel, the first byte in memory being the least significant one.
+ */
+using PixelTable = std::array<uint32_t, 16>;
+
+/**
+ * @brief Decodes 2bpp tile rows into one color index per pixel.
+ *
+ * Uses AVX2 or SSSE3 when the CPU supports them, and a table-driven implementation otherwise. All give the same
+ * result.
+ *
+ * @param planes The rows as stored in the VRAM: for each row, the low bitplane byte then the high bitplane byte.
+ * @param rows Number of rows to decode.
+ * @param pixels Receives 8 color indices (0-3) per row, from left to right.
+ */
+void decode_tile_rows(const uint8_t* planes, size_t rows, uint8_t* pixels);
+
+/**
+ * @brief Builds the table mapping the color codes to shades for the given palettes.
+ *
+ * @param bgp Background palette (BGP).
+ * @param obp0 First object palette (OBP0).
+ * @param obp1 Second object palette (OBP1).
+ * @return The table to give to map_palettes().
+ */
+PaletteTable make_palette_table(uint8_t bgp, uint8_t obp0, uint8_t obp1);
+
+/**
+ * @brief Maps color codes to shades (0 = white to 3 = black) through a palette table.
+ *
+ * Uses a byte shuffle (AVX2 or SSSE3) when the CPU supports it, and a table lookup per pixel otherwise.
+ *
+ * @param codes Color codes, each one below 16.
+ * @param count Number of codes.
+ * @param table Palette table given by make_palette_table().
+ * @param shades Receives one shade per code. May be the same buffer as codes.
+ */
+void map_palettes(const uint8_t* codes, size_t count, const PaletteTable& table, uint8_t* shades);
+
+/**
+ * @brief Builds the table mapping the color codes to pixels in a given format.
+ *
+ * @param palettes Palette table mapping the color codes to shades, given by make_palette_table().
+ * @param format Format of the pixels.
+ * @return The table to give to write_pixels().
+ */
+PixelTable make_pixel_table(const PaletteTable& palettes, PixelFormat format);
+
+/**
+ * @brief Maps color codes to pixels in a given format through a pixel table.
+ *
+ * Uses byte shuffles (SSSE3) when the CPU supports them, and a table lookup per pixel otherwise.
+ *
+ * @param codes Color codes, each one below 16.
+ * @param count Number of codes.
+ * @param table Pixel table given by make_pixel_table() for the same format.
+ * @param format Format of the pixels.
+ * @param pixels Receives count pixels of bytes_per_pixel(format) bytes.
+ */
+void write_pixels(const uint8_t* codes, size_t count, const PixelTable& table, PixelFormat format, uint8_t* pixels);
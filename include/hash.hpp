@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Computes the CRC32C (Castagnoli) checksum of a buffer.
+ *
+ * Uses the SSE4.2 crc32 instruction on three interleaved streams when the CPU supports it, and a table-driven
+ * implementation otherwise. Both give the same result.
+ *
+ * @param data Start of the buffer.
+ * @param size Size of the buffer in bytes.
+ * @param crc Checksum of the data preceding the buffer, to hash a stream in several calls.
+ * @return The checksum of the data hashed so far.
+ */
+uint32_t crc32c(const uint8_t* data, size_t size, uint32_t crc = 0);
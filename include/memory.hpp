@@ -1,6 +1,15 @@
 #pragma once
 
+#include "cartridge.hpp"
+#include "save_file.hpp"
+#include "scheduler.hpp"
+#include "video_log.hpp"
 #include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
 #include <string>
 #include <vector>
 
@@ -19,6 +28,23 @@ inline bool is_in_between(uint16_t value, uint16_t a, uint16_t b)
     return (a <= value) and (value <= b);
 }
 
+/**
+ * @brief Bitmap with one bit per 256-byte page of the 16-bit address space, the page of an address being its MSB.
+ */
+using PageBitmap = std::array<uint64_t, 4>;
+
+/**
+ * @brief Checks if a page is set in a page bitmap.
+ *
+ * @param bitmap Bitmap to look into.
+ * @param page Page number, i.e., the MSB of the addresses it contains.
+ * @return true if the bit of the page is set, false otherwise.
+ */
+inline bool is_page_set(const PageBitmap& bitmap, uint8_t page)
+{
+    return (bitmap[page >> 6] >> (page & 0x3f)) & 0x1;
+}
+
 /**
  * @brief Memory class, storing the ROM, RAM an so on.
  */
@@ -26,48 +52,468 @@ class Memory {
 public:
     /**
      * @brief Class constructor
+     *
+     * @param scheduler System scheduler, used to time the DMA transfers and to notify the PPU of the LCDC writes.
      */
-    Memory();
+    Memory(Scheduler& scheduler);
+    Memory(const Memory&) = delete;
+    Memory& operator=(const Memory&) = delete;
 
     static constexpr uint16_t IF_ADDR = 0xff0f;
     static constexpr uint16_t IE_ADDR = 0xffff;
+    static constexpr uint16_t DMA_ADDR = 0xff46;
+    static constexpr uint64_t OAM_DMA_CYCLES = 640; /**< Duration of an OAM DMA transfer: 160 M-cycles. */
+    static constexpr uint16_t P1_ADDR = 0xff00;
+    static constexpr uint16_t LCDC_ADDR = 0xff40;
+    static constexpr uint16_t STAT_ADDR = 0xff41;
+    static constexpr uint16_t LY_ADDR = 0xff44;
+    static constexpr uint16_t LYC_ADDR = 0xff45;
+    static constexpr uint16_t LCD_REGISTERS_ADDR = 0xff40; /**< First LCD register (LCDC). */
+    static constexpr uint16_t LCD_REGISTERS_END = 0xff4b; /**< Last LCD register (WX). */
+    static constexpr size_t TILE_ROWS = 384 * 8; /**< Number of tile rows in the tile data area (0x8000-0x97ff). */
+    static constexpr uint8_t INTERRUPT_VBLANK = 1 << 0; /**< IF/IE bit of the VBlank interrupt. */
+    static constexpr uint8_t INTERRUPT_STAT = 1 << 1; /**< IF/IE bit of the LCD STAT interrupt. */
+    static constexpr uint8_t INTERRUPT_TIMER = 1 << 2; /**< IF/IE bit of the timer interrupt. */
+    static constexpr uint8_t INTERRUPT_SERIAL = 1 << 3; /**< IF/IE bit of the serial interrupt. */
     /**
      * @brief Loads a ROM into memory.
      *
+     * Also allocates the cartridge RAM described in the header. Battery-backed cartridges get it mapped from a .sav
+     * file next to the ROM, so that the game progress survives between sessions.
+     *
      * @param filename Path of the Game Boy ROM file (.gb).
-     * @throws std::runtime_error if the ROM file could not be opened.
+     * @throws std::runtime_error if the ROM file could not be opened, or its save file could not be mapped.
      */
     void load_rom(const std::string& filename);
+    /**
+     * @brief Sets the delay between two background flushes of the save file to the disk.
+     *
+     * @param interval New delay. Zero disables periodic flushing, the save is then only written on exit.
+     */
+    void set_save_flush_interval(std::chrono::milliseconds interval);
+    /**
+     * @brief Gives the description of the loaded cartridge.
+     *
+     * @return The header fields and content hash of the ROM.
+     */
+    const CartridgeInfo& cartridge_info() const { return cartridge; }
     /**
      * @brief Reads a byte from the memory at a given address.
      *
+     * Plain memory pages are read straight through the memory map, the others (I/O, OAM, watched pages...) go
+     * through read_slow().
+     *
      * @param address Address of the byte to read.
      * @return The value of the byte at this address, given by copy.
      */
-    uint8_t read_byte(uint16_t address);
+    uint8_t read8(uint16_t address)
+    {
+#ifdef GAMEBOY_HEATMAP
+        count_access(address, HEAT_READ);
+#endif
+        const uint8_t* page = read_map[address >> 8];
+        if (page) [[likely]]
+            return page[address & 0xff];
+        return read_slow(address);
+    }
     /**
-     * @brief Reads a byte from the memory at a given address.
+     * @brief Reads the opcode byte the CPU is about to execute.
      *
-     * @param address Address of the byte to read.
-     * @return The value of the byte at this address, given by reference.
+     * Same as read8(), except that execute watchpoints are the ones triggered instead of read watchpoints.
+     *
+     * @param address Address of the opcode.
+     * @return The value of the byte at this address.
      */
-    uint8_t& at(uint16_t address);
+    uint8_t fetch_opcode(uint16_t address)
+    {
+#ifdef GAMEBOY_HEATMAP
+        count_access(address, HEAT_EXECUTE);
+#endif
+#ifdef GAMEBOY_WATCHPOINTS
+        const uint8_t* page = exec_map[address >> 8];
+        if (page) [[likely]]
+            return page[address & 0xff];
+        return fetch_opcode_slow(address);
+#else
+        const uint8_t* page = read_map[address >> 8];
+        if (page) [[likely]]
+            return page[address & 0xff];
+        return read_slow(address);
+#endif
+    }
     /**
      * @brief Writes the value of a byte in the memory at a given address.
      *
      * @param address Address to write to.
      * @param value New value of the byte.
      */
-    void write_byte(uint16_t address, uint8_t value);
+    void write8(uint16_t address, uint8_t value)
+    {
+#ifdef GAMEBOY_HEATMAP
+        count_access(address, HEAT_WRITE);
+#endif
+        uint8_t* page = write_map[address >> 8];
+        if (page) [[likely]] {
+            page[address & 0xff] = value;
+            mark_dirty(address);
+            return;
+        }
+        write_slow(address, value);
+    }
+    /**
+     * @brief Reads a little-endian 16-bit word from the memory.
+     *
+     * @param address Address of the low byte.
+     * @return The word made from the bytes at address and address + 1.
+     */
+    uint16_t read16(uint16_t address)
+    {
+        uint8_t lo = read8(address);
+        uint8_t hi = read8(address + 1);
+        return static_cast<uint16_t>(lo | (hi << 8));
+    }
+    /**
+     * @brief Writes a little-endian 16-bit word in the memory, low byte first.
+     *
+     * @param address Address of the low byte.
+     * @param value New value of the word.
+     */
+    void write16(uint16_t address, uint16_t value)
+    {
+        write8(address, value & 0xff);
+        write8(address + 1, value >> 8);
+    }
+    /**
+     * @brief Gives the pages written since the last clear.
+     *
+     * VRAM, cartridge RAM, WRAM, OAM and HRAM writes are tracked. Echo RAM writes are reported on the WRAM page
+     * they land in.
+     *
+     * @return The dirty page bitmap.
+     */
+    const PageBitmap& dirty_pages() const { return dirty; }
+    /**
+     * @brief Marks every page as clean.
+     */
+    void clear_dirty_pages() { dirty.fill(0); }
+    /**
+     * @brief Gives the pages written since the last clear and marks them as clean.
+     *
+     * @return The dirty page bitmap before clearing.
+     */
+    PageBitmap take_dirty_pages()
+    {
+        PageBitmap pages = dirty;
+        dirty.fill(0);
+        return pages;
+    }
+
+    /**
+     * @brief Gives the value of an I/O register to the hardware components.
+     *
+     * @param address Address of the register, between 0xff00 and 0xff7f.
+     * @return The value of the register.
+     */
+    uint8_t io_register(uint16_t address) const { return io_regs[address - 0xff00]; }
+    /**
+     * @brief Sets an I/O register from the hardware components, bypassing the rules of the CPU writes.
+     *
+     * @param address Address of the register, between 0xff00 and 0xff7f.
+     * @param value New value of the register.
+     */
+    void set_io_register(uint16_t address, uint8_t value) { io_regs[address - 0xff00] = value; }
+    /**
+     * @brief Flags an interrupt as requested in IF.
+     *
+     * @param interrupt IF bit of the interrupt, e.g., INTERRUPT_VBLANK.
+     */
+    void request_interrupt(uint8_t interrupt) { io_regs[IF_ADDR - 0xff00] |= interrupt; }
+    /**
+     * @brief Gives the value of the Interrupt Enable register to the hardware components.
+     *
+     * Unlike read8() and write8(), neither this nor io_register() counts in the access heatmap: the polling of the
+     * registers by the emulator is not an access of the program. Only the program writes IE, through write8().
+     *
+     * @return The value of the register.
+     */
+    uint8_t interrupt_enable() const { return interrupt_reg; }
+    /**
+     * @brief Gives the video RAM to the PPU.
+     *
+     * @return The 8 KB of VRAM (0x8000-0x9fff).
+     */
+    const std::array<uint8_t, 0x2000>& video_ram() const { return vram; }
+    /**
+     * @brief Gives the object attribute memory to the PPU.
+     *
+     * @return The 40 objects of 4 bytes (0xfe00-0xfe9f).
+     */
+    const std::array<uint8_t, 0xa0>& object_attributes() const { return oam; }
+    /**
+     * @brief Memory areas the PPU draws from, with the tracking of their changes.
+     *
+     * Given by Memory for its own areas, or built on a copy of them.
+     */
+    struct VideoView {
+        const uint8_t* vram; /**< The 8 KB of VRAM (0x8000-0x9fff). */
+        const uint8_t* oam; /**< The 160 bytes of OAM (0xfe00-0xfe9f). */
+        const uint8_t* lcd_registers; /**< The LCD registers, from LCD_REGISTERS_ADDR to LCD_REGISTERS_END. */
+        /**
+         * @brief One bit per tile row (TILE_ROWS of them) written since the reader last decoded it, the reader
+         * clearing them. Every row is flagged after power on.
+         */
+        uint64_t* stale_tile_rows;
+        const uint32_t* oam_generation; /**< Counter changing whenever the OAM is written. */
+    };
+
+    /**
+     * @brief Gives the video memory to the PPU.
+     *
+     * @return The view on the VRAM, the OAM and the LCD registers of this memory.
+     */
+    VideoView video_view()
+    {
+        return { vram.data(), oam.data(), &io_regs[LCD_REGISTERS_ADDR - 0xff00], stale_tile_rows.data(), &oam_writes };
+    }
+    /**
+     * @brief Logs the video memory writes from now on, until called with nullptr.
+     *
+     * Tile map writes then leave the fast path, as every VRAM write has to be logged.
+     *
+     * @param log Log receiving the writes to the VRAM, the OAM and the LCD registers, OAM DMA transfers included.
+     */
+    void set_video_log(VideoLog* log);
+    /**
+     * @brief Write to an LCD register, kept so that the scanline renderer can draw the changes made in the middle of
+     * a line.
+     */
+    struct LcdWrite {
+        uint64_t cycle; /**< System cycle of the write. */
+        uint8_t index; /**< Written register, relative to LCD_REGISTERS_ADDR. */
+        uint8_t old_value; /**< Value of the register before the write. */
+        uint8_t value; /**< Written value. */
+    };
+    static constexpr size_t LCD_WRITES_KEPT = 64; /**< Number of LCD register writes kept between two clears. */
+
+    /**
+     * @brief Gives the LCD register writes made since the last clear, STAT and LY excepted.
+     *
+     * @return The writes, oldest first. Only the first LCD_WRITES_KEPT ones are kept.
+     */
+    std::span<const LcdWrite> lcd_writes() const { return { lcd_write_log.data(), lcd_write_count }; }
+    /**
+     * @brief Forgets the LCD register writes, done by the PPU as each line starts drawing.
+     */
+    void clear_lcd_writes() { lcd_write_count = 0; }
+    /**
+     * @brief Gives the memory owned by this instance outside of the object itself.
+     *
+     * @return The size in bytes of the cartridge RAM, allocated or mapped from the save file, and of the bookkeeping.
+     */
+    size_t heap_bytes() const;
+    /**
+     * @brief Gives the memory this instance shares with the other ones.
+     *
+     * @return The size in bytes of the ROM image.
+     */
+    size_t shared_bytes() const { return rom.size(); }
+
+#ifdef GAMEBOY_WATCHPOINTS
+    static constexpr uint8_t WATCH_READ = 1 << 0; /**< Watch data reads. */
+    static constexpr uint8_t WATCH_WRITE = 1 << 1; /**< Watch data writes. */
+    static constexpr uint8_t WATCH_EXECUTE = 1 << 2; /**< Watch opcode fetches. */
+
+    /**
+     * @brief Function called when a watched access happens.
+     *
+     * It receives the accessed address, the value read, written or executed and the kind of access (one of the
+     * WATCH_* flags). It returns true to break, i.e., to make the running emulation return to its caller.
+     */
+    using WatchCallback = std::function<bool(uint16_t address, uint8_t value, uint8_t kind)>;
+
+    /**
+     * @brief Watches accesses to an address range.
+     *
+     * Only the pages containing the range leave the fast memory map, the other addresses are not slowed down. Called
+     * from a watchpoint callback, the watchpoint is added once the callbacks of the current access returned, and
+     * watches from the next access.
+     *
+     * @param first First watched address.
+     * @param last Last watched address (included).
+     * @param kinds Combination of WATCH_READ, WATCH_WRITE and WATCH_EXECUTE.
+     * @param callback Function called on each watched access. Without one, every access breaks.
+     * @return Identifier of the watchpoint, used to remove it.
+     */
+    int add_watchpoint(uint16_t first, uint16_t last, uint8_t kinds, WatchCallback callback = {});
+    /**
+     * @brief Removes a watchpoint. Called from a watchpoint callback, the removal is applied once the callbacks of the
+     * current access returned, the watchpoint can still be called for that access.
+     *
+     * @param id Identifier given by add_watchpoint().
+     */
+    void remove_watchpoint(int id);
+    /**
+     * @brief Checks if a watchpoint asked the emulation to break.
+     *
+     * @return true if a break is pending, false otherwise.
+     */
+    bool break_requested() const { return watch_break; }
+    /**
+     * @brief Acknowledges a break so that the emulation can be resumed.
+     */
+    void clear_break() { watch_break = false; }
+#endif
+
+#ifdef GAMEBOY_HEATMAP
+    /**
+     * @brief Writes the access heatmap as CSV: one row per 256-byte page below 0xff00, and one per address above.
+     *
+     * Each row gives the first and last address of the block, then its read, write and execute counts. Blocks
+     * that were never accessed are skipped.
+     *
+     * @param path Path of the CSV file.
+     * @throws std::runtime_error if the file could not be written.
+     */
+    void export_heatmap(const std::string& path) const;
+#endif
 
 private:
-    std::vector<uint8_t> rom; /**< Cartridge ROM data, dynamically sized to the loaded game. */
-    std::array<uint8_t, 0x2000> vram; /**< Video RAM, stores tile and background graphics. */
-    std::array<uint8_t, 0x2000> ram; /**< External cartridge RAM, battery-backed in some cartridges. */
-    std::array<uint8_t, 0x2000> wram; /**< Work RAM internal to the Game Boy. */
-    std::array<uint8_t, 0xA0> oam; /**< Object Attribute Memory, stores sprite attributes. */
+    Scheduler& scheduler; /**< System scheduler. */
+    std::shared_ptr<const std::vector<uint8_t>> rom_image; /**< Cartridge ROM data, shared with the other instances. */
+    std::span<const uint8_t> rom; /**< View of the ROM image, empty until a game is loaded. */
+    CartridgeInfo cartridge; /**< Description of the loaded cartridge. */
+    std::array<uint8_t, 0x2000> vram {}; /**< Video RAM, stores tile and background graphics. */
+    std::vector<uint8_t> ram; /**< External cartridge RAM, used when the cartridge has no battery. */
+    std::unique_ptr<SaveFile> save_file; /**< External cartridge RAM of battery-backed cartridges. */
+    std::span<uint8_t> sram; /**< Cartridge RAM in use, either ram or the save file mapping. */
+    std::chrono::milliseconds save_flush_interval { 5000 }; /**< Delay between two flushes of the save file. */
+    std::array<uint8_t, 0x2000> wram {}; /**< Work RAM internal to the Game Boy. */
+    std::array<uint8_t, 0xa0> oam {}; /**< Object Attribute Memory, stores sprite attributes. */
     std::array<uint8_t, 0x80> io_regs; /**< I/O Registers, hardware control and status. */
-    std::array<uint8_t, 0x7f> hram; /**< High RAM, fast internal memory. */
-    uint8_t interrupt_reg; /**< Interrupt Enable Register. */
+    std::array<uint8_t, 0x7f> hram {}; /**< High RAM, fast internal memory. */
+    uint8_t interrupt_reg {}; /**< Interrupt Enable Register. */
     uint8_t default_return = 0xff; /**< Default return value for fetching. */
+    PageBitmap dirty {}; /**< Pages of writable memory written since the last clear. */
+    uint32_t oam_writes {}; /**< Number of OAM writes and DMA transfers, see VideoView. */
+    std::array<uint64_t, TILE_ROWS / 64> stale_tile_rows; /**< Tile rows written since the PPU last decoded them. */
+    std::array<const uint8_t*, 0x100> read_map {}; /**< Start of each readable page, nullptr to use read_slow(). */
+    std::array<uint8_t*, 0x100> write_map {}; /**< Start of each writable page, nullptr to use write_slow(). */
+    bool oam_dma_active { false }; /**< true while an OAM DMA transfer holds the bus, only HRAM is reachable. */
+    VideoLog* video_log { nullptr }; /**< Log of the video memory writes, nullptr when they are not logged. */
+    std::array<LcdWrite, LCD_WRITES_KEPT> lcd_write_log {}; /**< LCD register writes since the last clear. */
+    size_t lcd_write_count {}; /**< Number of writes in lcd_write_log. */
+#ifdef GAMEBOY_HEATMAP
+    static constexpr size_t HEAT_READ = 0; /**< Heatmap column of the data reads. */
+    static constexpr size_t HEAT_WRITE = 1; /**< Heatmap column of the data writes. */
+    static constexpr size_t HEAT_EXECUTE = 2; /**< Heatmap column of the opcode fetches. */
+    /**
+     * @brief Access counts of each block: the 255 pages below 0xff00, then the 256 addresses of the 0xff page.
+     */
+    std::array<std::array<uint64_t, 3>, 0x1ff> heatmap {};
+
+    /**
+     * @brief Counts an access in the heatmap.
+     *
+     * @param address Accessed address.
+     * @param kind Kind of the access, one of the HEAT_* columns.
+     */
+    void count_access(uint16_t address, size_t kind)
+    {
+        size_t block = address < 0xff00 ? address >> 8 : 0xff + (address & 0xff);
+        ++heatmap[block][kind];
+    }
+#endif
+#ifdef GAMEBOY_WATCHPOINTS
+    /**
+     * @brief Address range watched for some kinds of accesses.
+     */
+    struct Watchpoint {
+        int id; /**< Identifier given to the caller. */
+        uint16_t first; /**< First watched address. */
+        uint16_t last; /**< Last watched address (included). */
+        uint8_t kinds; /**< Watched kinds of accesses. */
+        WatchCallback callback; /**< Function called on each watched access. */
+    };
+    std::array<const uint8_t*, 0x100> exec_map {}; /**< Start of each page for opcode fetches, nullptr if slow. */
+    std::array<uint8_t, 0x100> watched_pages {}; /**< Kinds of accesses watched somewhere in each page. */
+    std::vector<Watchpoint> watchpoints; /**< Registered watchpoints. */
+    int next_watch_id { 0 }; /**< Identifier of the next added watchpoint. */
+    bool watch_break { false }; /**< true when a watchpoint asked to break. */
+    bool checking_watchpoints { false }; /**< true while the callbacks of an access run. */
+    std::vector<Watchpoint> added_watchpoints; /**< Watchpoints added by the callbacks of the current access. */
+    std::vector<int> removed_watchpoints; /**< Watchpoints removed by the callbacks of the current access. */
+
+    /**
+     * @brief Reads an opcode from a page that is not in the fast execute map.
+     *
+     * @param address Address of the opcode.
+     * @return The value of the byte at this address.
+     */
+    uint8_t fetch_opcode_slow(uint16_t address);
+    /**
+     * @brief Calls the watchpoints covering an access.
+     *
+     * @param address Accessed address.
+     * @param value Value read, written or executed.
+     * @param kind Kind of the access, one of the WATCH_* flags.
+     */
+    void check_watchpoints(uint16_t address, uint8_t value, uint8_t kind);
+    /**
+     * @brief Recomputes the watched pages from the watchpoints and rebuilds the memory map.
+     */
+    void update_watched_pages();
+#endif
+
+    /**
+     * @brief Rebuilds the memory map, after a ROM load, a change of the watched pages or a DMA transfer.
+     */
+    void update_memory_map();
+    /**
+     * @brief Gives the start of a page of plain readable memory (ROM, VRAM, cartridge RAM, WRAM and its echo).
+     *
+     * @param page Page number.
+     * @return Pointer to the start of the page, nullptr if the page does not hold plain memory.
+     */
+    const uint8_t* readable_page(uint8_t page);
+    /**
+     * @brief Starts an OAM DMA transfer.
+     *
+     * The 160 bytes are copied at once, then the CPU is restricted to HRAM until the transfer would have ended on
+     * the real hardware. The restriction is applied by emptying the memory map, so normal accesses pay nothing.
+     *
+     * @param source MSB of the source address.
+     */
+    void start_oam_dma(uint8_t source);
+    /**
+     * @brief Ends the OAM DMA transfer and gives the bus back to the CPU.
+     */
+    void end_oam_dma();
+    /**
+     * @brief Reads a byte by decoding the memory area its address belongs to.
+     *
+     * @param address Address of the byte to read.
+     * @return The value of the byte at this address.
+     */
+    uint8_t read_area(uint16_t address);
+    /**
+     * @brief Reads a byte that is not in the fast memory map.
+     *
+     * @param address Address of the byte to read.
+     * @return The value of the byte at this address.
+     */
+    uint8_t read_slow(uint16_t address);
+    /**
+     * @brief Writes a byte that is not in the fast memory map.
+     *
+     * @param address Address to write to.
+     * @param value New value of the byte.
+     */
+    void write_slow(uint16_t address, uint8_t value);
+
+    /**
+     * @brief Flags the page of an address as written.
+     *
+     * @param address Address of the written byte.
+     */
+    void mark_dirty(uint16_t address) { dirty[address >> 14] |= uint64_t(1) << ((address >> 8) & 0x3f); }
 };
@@ -0,0 +1,143 @@
+#pragma once
+
+#include "ppu.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/**
+ * @brief Downscaled gray observations of the screen, e.g. for learning agents, with the last ones kept in a ring.
+ *
+ * The PPU writes each drawn frame in 8-bit gray into one of two buffers of this class (see frame_target()). Every
+ * frames_per_observation frames, the last drawn frame, optionally max-pooled with the frame drawn before it (which
+ * removes the flicker of the objects shown every other frame), is area-averaged down to the observation size and
+ * stored in the ring. The ring keeps each observation twice, so that the last ones are always contiguous, oldest
+ * first, and can be read in place as a stack.
+ */
+class Observations {
+public:
+    /**
+     * @brief Settings of the observations.
+     */
+    struct Config {
+        int width { 84 }; /**< Width of an observation, 1 to PPU::SCREEN_WIDTH. */
+        int height { 84 }; /**< Height of an observation, 1 to PPU::SCREEN_HEIGHT. */
+        uint32_t history { 4 }; /**< Number of observations kept. */
+        /**
+         * Number of emulated frames per observation. With render skipping, only the last two frames of each period
+         * need to be drawn (see GameBoy::render_next_frames()).
+         */
+        uint32_t frames_per_observation { 1 };
+        /**
+         * true to take the largest gray value of the last two drawn frames for each pixel, as the usual Atari
+         * preprocessing does.
+         */
+        bool max_pool { true };
+    };
+
+    /**
+     * @brief Class constructor, the ring starting black.
+     *
+     * @param config Settings of the observations.
+     * @throws std::runtime_error if a size is out of range or the history or period is 0.
+     */
+    Observations(const Config& config);
+
+    /**
+     * @brief Gives the buffer the next drawn frame goes to, PPU::SCREEN_HEIGHT rows of PPU::SCREEN_WIDTH gray bytes.
+     *
+     * @return The buffer, which changes after each drawn frame.
+     */
+    uint8_t* frame_target() { return frames.data() + target * FRAME_BYTES; }
+    /**
+     * @brief Ends an emulated frame, taking an observation at the end of each period. Called between two frames, the
+     * frame drawn next then goes to the other buffer.
+     *
+     * @param drawn true if the frame was drawn into frame_target().
+     */
+    void end_frame(bool drawn);
+    /**
+     * @brief Gives the last observations.
+     *
+     * @return history() observations of height() rows of width() bytes, oldest first. Stays valid and in place
+     * until the next observation.
+     */
+    std::span<const uint8_t> stack() const;
+    /**
+     * @brief Gives the last observation.
+     *
+     * @return height() rows of width() gray bytes, from 0x00 = black to 0xff = white.
+     */
+    std::span<const uint8_t> latest() const { return stack().last(observation_bytes); }
+    /**
+     * @brief Gives the number of observations taken so far.
+     *
+     * @return The observation counter.
+     */
+    uint64_t count() const { return observations; }
+    /**
+     * @brief Gives the width of an observation.
+     *
+     * @return The width, in pixels.
+     */
+    int width() const { return config.width; }
+    /**
+     * @brief Gives the height of an observation.
+     *
+     * @return The height, in pixels.
+     */
+    int height() const { return config.height; }
+    /**
+     * @brief Gives the number of observations kept.
+     *
+     * @return The number of observations in stack().
+     */
+    uint32_t history() const { return config.history; }
+    /**
+     * @brief Gives the memory used by the observations, this object included as it is allocated by the GameBoy.
+     *
+     * @return The size in bytes of the object, the two frames, the ring and the taps.
+     */
+    size_t heap_bytes() const;
+
+private:
+    static constexpr size_t FRAME_BYTES = PPU::SCREEN_WIDTH * PPU::SCREEN_HEIGHT; /**< Size of a gray frame. */
+
+    /**
+     * @brief Source pixels averaged into each output pixel, along one axis.
+     *
+     * The output pixel j averages count source pixels from firsts[j], with the weights weights[j * count] to
+     * weights[j * count + count - 1]. The weights are in 1/output size of a source pixel, so the ones of an output
+     * pixel sum up to the source size.
+     */
+    struct Taps {
+        std::vector<uint16_t> firsts; /**< First source pixel of each output pixel. */
+        std::vector<uint16_t> weights; /**< Weights of the source pixels, zero past the covered ones. */
+        size_t count; /**< Number of source pixels per output pixel, the same for all of them. */
+    };
+
+    Config config; /**< Settings. */
+    size_t observation_bytes; /**< Size of an observation. */
+    std::vector<uint8_t> frames; /**< The two last drawn frames. */
+    uint8_t target {}; /**< Index of the frame drawn next. */
+    uint64_t frames_ended {}; /**< Number of frames ended. */
+    std::vector<uint8_t> ring; /**< The observations, each one stored at its slot and history slots further. */
+    uint64_t observations {}; /**< Number of observations taken. */
+    Taps row_taps; /**< Source rows of the output rows. */
+    Taps column_taps; /**< Source columns of the output columns. */
+
+    /**
+     * @brief Computes the taps of an axis.
+     *
+     * @param source Size of the source, in pixels.
+     * @param output Size of the output, in pixels.
+     * @param min_count Minimum number of source pixels per output pixel.
+     * @return The taps. The last ones can be past the end of the source, with zero weights.
+     */
+    static Taps make_taps(int source, int output, size_t min_count);
+    /**
+     * @brief Downscales the last drawn frame, pooled if enabled, into the next slot of the ring.
+     */
+    void observe();
+};
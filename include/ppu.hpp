@@ -1,4 +1,596 @@
+#pragma once
+
+#include "graphics.hpp"
+#include "memory.hpp"
+#include "scheduler.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+
+class RenderThread;
+
+/**
+ * @brief Pixel Processing Unit, drawing the screen from the VRAM, the OAM and the LCD registers.
+ *
+ * The PPU steps through the 154 lines of a frame (144 visible, then 10 of VBlank), each one lasting 456 dots: OAM
+ * scan (mode 2), drawing (mode 3) then HBlank (mode 0). It keeps LY and the STAT mode up to date, raises the VBlank
+ * and STAT interrupts. Its state only changes on mode changes, which are scheduled as events: the PPU does nothing in
+ * between.
+ *
+ * Two renderers share this timing and register state, and can be switched between frames:
+ * - the scanline renderer draws each visible line in one go when it enters HBlank, with a fixed drawing duration.
+ *   It is the cheapest one and is enough for most games. The LCD register writes made during the drawing split the
+ *   line into spans drawn with the values of the time, which keeps the usual raster effects.
+ * - the pixel FIFO renderer steps the background fetcher and the pixel FIFOs every dot of mode 3, so the drawing
+ *   lasts as long as on the hardware (fine scroll, window and object penalties) and the register writes made in the
+ *   middle of a line apply from the next pixel.
+ *
+ * The scanline renderer can also draw on a render thread, from a log of the video memory writes (see RenderThread).
+ * The timing stays on the emulation thread, only the pixels are computed on the other one.
+ */
 class PPU {
 public:
-    void cycle();
+    static constexpr int SCREEN_WIDTH = 160; /**< Width of the screen in pixels. */
+    static constexpr int SCREEN_HEIGHT = 144; /**< Height of the screen in pixels. */
+    static constexpr int DOTS_PER_LINE = 456; /**< Duration of a line, in dots (i.e., cycles). */
+    static constexpr int LINES_PER_FRAME = 154; /**< Number of lines of a frame, VBlank included. */
+    static constexpr int OAM_SCAN_DOTS = 80; /**< Duration of the OAM scan (mode 2). */
+    static constexpr int DRAWING_DOTS = 172; /**< Duration of the drawing (mode 3), without the penalties. */
+    /**< Dots from the start of the drawing to the output of the first pixel, without the fine scroll. */
+    static constexpr int FIRST_PIXEL_DOTS = 12;
+
+    static constexpr uint16_t LCDC_ADDR = 0xff40;
+    static constexpr uint16_t STAT_ADDR = 0xff41;
+    static constexpr uint16_t SCY_ADDR = 0xff42;
+    static constexpr uint16_t SCX_ADDR = 0xff43;
+    static constexpr uint16_t LY_ADDR = 0xff44;
+    static constexpr uint16_t LYC_ADDR = 0xff45;
+    static constexpr uint16_t BGP_ADDR = 0xff47;
+    static constexpr uint16_t OBP0_ADDR = 0xff48;
+    static constexpr uint16_t OBP1_ADDR = 0xff49;
+    static constexpr uint16_t WY_ADDR = 0xff4a;
+    static constexpr uint16_t WX_ADDR = 0xff4b;
+
+    /**
+     * @brief PPU modes, as reported in the two lower bits of STAT.
+     */
+    enum class Mode : uint8_t {
+        HBlank = 0,
+        VBlank = 1,
+        OamScan = 2,
+        Drawing = 3,
+    };
+
+    /**
+     * @brief Rendering methods, from the cheapest to the most accurate.
+     */
+    enum class Renderer : uint8_t {
+        Scanline, /**< Whole lines rendered on entering HBlank. */
+        PixelFifo, /**< Dot by dot rendering through the pixel FIFOs. */
+    };
+
+    /**
+     * @brief Screen content, one shade (0 = white to 3 = black) per pixel, row by row.
+     */
+    using Framebuffer = std::array<uint8_t, SCREEN_WIDTH * SCREEN_HEIGHT>;
+
+    /**
+     * @brief Destination of the drawn lines: the internal framebuffer or a buffer of the embedder. Also hashes the
+     * lines written.
+     */
+    class FrameOutput {
+    public:
+        /**
+         * @brief Class constructor, the lines going to a newly allocated internal framebuffer.
+         */
+        FrameOutput()
+            : frame(std::make_unique<Framebuffer>())
+            , pixels(frame->data())
+        {
+        }
+        FrameOutput(const FrameOutput&) = delete;
+        FrameOutput& operator=(const FrameOutput&) = delete;
+
+        /**
+         * @brief Changes the destination buffer. See PPU::set_output().
+         *
+         * @param pixels The buffer, nullptr for the internal framebuffer. The internal framebuffer is freed while
+         * another buffer is set, and allocated again, white, when it is set back.
+         * @param format Format of the pixels.
+         * @param stride Distance between the starts of two rows, in bytes.
+         * @throws std::runtime_error if the stride is smaller than a row.
+         */
+        void set(uint8_t* pixels, PixelFormat format, size_t stride);
+        /**
+         * @brief Changes the gray buffer written besides the destination. See PPU::set_gray_output().
+         *
+         * @param pixels The buffer, nullptr for none.
+         */
+        void set_gray(uint8_t* pixels) { gray = pixels; }
+        /**
+         * @brief Writes a line and adds its shades to the hash.
+         *
+         * @param ly Line to write.
+         * @param codes Color codes of the line.
+         * @param palettes Table mapping the codes to shades.
+         */
+        void write_line(uint8_t ly, const uint8_t* codes, const PaletteTable& palettes);
+        /**
+         * @brief Fills the destination with white, without hashing.
+         */
+        void blank();
+        /**
+         * @brief Gives the hash of the lines written since the last reset_hash() call.
+         *
+         * @return The CRC32C of the shades of the lines.
+         */
+        uint32_t hash() const { return line_hash; }
+        /**
+         * @brief Restarts the hash, at the start of a frame.
+         */
+        void reset_hash() { line_hash = 0; }
+        /**
+         * @brief Gives the internal framebuffer.
+         *
+         * @return The framebuffer, up to date when no other destination is set. While one is, a white framebuffer.
+         */
+        const Framebuffer& framebuffer() const;
+        /**
+         * @brief Gives the memory allocated by the output.
+         *
+         * @return The size of the internal framebuffer, 0 while another destination is set.
+         */
+        size_t heap_bytes() const { return frame ? sizeof(Framebuffer) : 0; }
+
+    private:
+        std::unique_ptr<Framebuffer> frame; /**< Internal framebuffer, nullptr while another destination is set. */
+        uint8_t* pixels; /**< Buffer the lines are written to, frame by default. */
+        PixelFormat format { PixelFormat::Shade2 }; /**< Format of the pixels. */
+        size_t stride { SCREEN_WIDTH }; /**< Distance between two rows, in bytes. */
+        uint32_t line_hash {}; /**< Hash of the lines written since the last reset. */
+        uint8_t* gray { nullptr }; /**< Gray buffer also written, of SCREEN_WIDTH bytes per row, if not nullptr. */
+    };
+
+    /**
+     * @brief Draws whole lines from the video memory, keeping the tiles decoded, the objects of each line sorted and
+     * the background of each line drawn until they are written.
+     */
+    class LineRenderer {
+    public:
+        /**
+         * @brief Objects shown on a line, at most 10.
+         */
+        struct LineObjects {
+            std::array<uint8_t, 10> in_oam_order; /**< OAM indices of the objects, in OAM order. */
+            std::array<uint8_t, 10> by_priority; /**< Same indices, smallest X first then in OAM order. */
+            uint8_t count; /**< Number of objects on the line. */
+        };
+        /**
+         * @brief LCD register write made while a line was drawn, taking effect from a given pixel.
+         */
+        struct RegisterWrite {
+            uint8_t x; /**< First pixel drawn with the new value, 0 to SCREEN_WIDTH. */
+            uint8_t index; /**< Written register, relative to LCDC_ADDR. */
+            uint8_t old_value; /**< Value of the register before the write. */
+            uint8_t value; /**< Written value. */
+        };
+        /**
+         * @brief Values of the LCD registers, from LCDC_ADDR to WX_ADDR.
+         */
+        using LcdRegisters = std::array<uint8_t, WX_ADDR - LCDC_ADDR + 1>;
+
+        /**
+         * @brief Class constructor.
+         *
+         * @param video Video memory to draw from.
+         */
+        LineRenderer(Memory::VideoView video)
+            : video(video)
+        {
+        }
+        /**
+         * @brief Draws a line: background, window and objects.
+         *
+         * The line is drawn with the current register values. The register writes made while it was drawn split it
+         * into spans, each one drawn with the values in effect on it: the writes are undone to find the values the
+         * line started with. Whether the window shows is decided per span, from its LCDC bits and WX.
+         *
+         * @param ly Line to draw.
+         * @param window_line Line of the window to draw, if WY was reached during the frame (see window_shown()).
+         * @param writes Register writes made while the line was drawn, by increasing x.
+         * @param output Destination of the line.
+         */
+        void draw_line(uint8_t ly, std::optional<uint8_t> window_line, std::span<const RegisterWrite> writes,
+            FrameOutput& output);
+        /**
+         * @brief Tells if the window shows on at least one span of a line, in which case the window line advances.
+         *
+         * @param registers Values of the LCD registers at the end of the line.
+         * @param writes Register writes made while the line was drawn, by increasing x.
+         * @return true if LCDC bits 0 and 5 are set and WX is on the screen on a span the window starts before the
+         * end of.
+         */
+        static bool window_shown(const uint8_t* registers, std::span<const RegisterWrite> writes);
+        /**
+         * @brief Allocates the tile cache and the background cache, if not done yet. Done by draw_line(), and by the
+         * PPU before a frame of the pixel FIFO renderer is drawn, which reads tile_row().
+         */
+        void allocate_caches();
+        /**
+         * @brief Frees the tile cache and the background cache, until allocate_caches() is called again.
+         */
+        void release_caches() { caches.reset(); }
+        /**
+         * @brief Gives the memory allocated by the renderer.
+         *
+         * @return The size of the caches, 0 while they are not allocated.
+         */
+        size_t heap_bytes() const { return caches ? sizeof(Caches) : 0; }
+        /**
+         * @brief Gives the objects of a line, rebuilding the lists of all the lines if the OAM or the object size
+         * changed.
+         *
+         * @param ly Visible line.
+         * @return The objects of the line.
+         */
+        const LineObjects& objects(uint8_t ly);
+        /**
+         * @brief Gives a tile row decoded to one color index per pixel, from the tile cache.
+         *
+         * @param row_address Address of the two bytes of the row in the VRAM, relative to 0x8000.
+         * @return The 8 color indices (0-3) of the row, from left to right.
+         */
+        const uint8_t* tile_row(uint16_t row_address)
+        {
+            uint16_t row = row_address >> 1;
+            uint64_t& stale = video.stale_tile_rows[row / 64];
+            if (stale) [[unlikely]] {
+                stale = 0;
+                refresh_tile_block(row / 64);
+            }
+            return caches->tile_cache.data() + row * 8;
+        }
+        /**
+         * @brief Gives the VRAM address of a tile, following the addressing mode of LCDC bit 4.
+         *
+         * @param lcdc Value of LCDC.
+         * @param index Tile index, as read from a tile map.
+         * @return The address of the tile, relative to 0x8000.
+         */
+        static uint16_t tile_address(uint8_t lcdc, uint8_t index)
+        {
+            return lcdc & 0x10 ? index * 16 : 0x1000 + static_cast<int8_t>(index) * 16;
+        }
+
+    private:
+        Memory::VideoView video; /**< Video memory to draw from. */
+        std::array<LineObjects, SCREEN_HEIGHT> object_lines {}; /**< Objects of each visible line. */
+        uint32_t tile_generation {}; /**< Number of tile block refreshes so far. */
+        /**< Value of tile_generation when each block of the tile cache was last refreshed. */
+        std::array<uint32_t, Memory::TILE_ROWS / 64> block_generations {};
+
+        /**
+         * @brief Background and window of a line as last drawn, with everything they were drawn from.
+         */
+        struct BackgroundLine {
+            std::array<uint8_t, SCREEN_WIDTH> codes; /**< Color codes of the background and the window. */
+            std::array<uint8_t, 32> bg_map_row; /**< Background tile map row the line was drawn from. */
+            std::array<uint8_t, 32> window_map_row; /**< Window tile map row, if the window showed. */
+            uint64_t tile_blocks; /**< Bit i set if the line used a tile of the block i of the tile cache. */
+            uint32_t generation; /**< Value of tile_generation once the line was drawn. */
+            bool drawn; /**< false until the line is drawn once. */
+            uint8_t lcdc; /**< Background and window bits of LCDC. */
+            uint8_t scy; /**< SCY. */
+            uint8_t scx; /**< SCX. */
+            uint8_t wx; /**< WX, if the window showed. */
+            int16_t window_line; /**< Line of the window drawn, -1 if it did not show. */
+        };
+        /**
+         * @brief Caches of the drawing, only allocated once a frame is drawn (about 60 KB).
+         */
+        struct Caches {
+            /**< Tile data decoded to one color index per pixel, refreshed 8 tiles at a time on VRAM writes. */
+            std::array<uint8_t, Memory::TILE_ROWS * 8> tile_cache;
+            /**< Last background drawn on each line, reused while its map row, tiles and registers are unchanged. */
+            std::array<BackgroundLine, SCREEN_HEIGHT> background_lines;
+        };
+        std::unique_ptr<Caches> caches; /**< The caches, nullptr until a frame is drawn or after release_caches(). */
+        uint32_t object_lines_generation {}; /**< OAM generation object_lines was built from. */
+        uint8_t object_lines_height {}; /**< Object height object_lines was built with, 0 before the first build. */
+
+        /**
+         * @brief Gives the value of an LCD register.
+         *
+         * @param address Address of the register.
+         * @return Its value.
+         */
+        uint8_t lcd_register(uint16_t address) const { return video.lcd_registers[address - LCDC_ADDR]; }
+        /**
+         * @brief Draws a line as color codes, with given register values.
+         *
+         * @param ly Line to draw.
+         * @param window_line Line of the window to draw, if WY was reached during the frame.
+         * @param registers Values of the LCD registers.
+         * @param line Receives the color codes of the line (see PaletteTable).
+         * @return The palette table of the registers.
+         */
+        PaletteTable draw_codes(uint8_t ly, std::optional<uint8_t> window_line, const uint8_t* registers,
+            std::array<uint8_t, SCREEN_WIDTH>& line);
+        /**
+         * @brief Draws the background and the window of a line, or reuses the last drawn ones if nothing they depend
+         * on changed since.
+         *
+         * @param ly Line to draw.
+         * @param window_line Line of the window to draw, if WY was reached during the frame. The window then shows if
+         * LCDC bit 5 is set and WX is on the screen.
+         * @param registers Values of the LCD registers, LCDC bit 0 being set.
+         * @param line Receives the color codes of the background and the window.
+         */
+        void draw_background(uint8_t ly, std::optional<uint8_t> window_line, const uint8_t* registers,
+            std::array<uint8_t, SCREEN_WIDTH>& line);
+        /**
+         * @brief Tells if the tiles of a line were changed since it was drawn, decoding again the ones written.
+         *
+         * @param background The line as drawn.
+         * @return true if one of its tile blocks was refreshed after it was drawn.
+         */
+        bool tiles_changed(const BackgroundLine& background);
+        /**
+         * @brief Rebuilds the object lists of all the visible lines from the OAM.
+         *
+         * @param height Height of the objects, 8 or 16 following LCDC bit 2.
+         */
+        void bucket_objects(uint8_t height);
+        /**
+         * @brief Decodes a block of 64 tile rows (8 tiles) into the tile cache.
+         *
+         * @param block Index of the block in the tile data area.
+         */
+        void refresh_tile_block(uint16_t block);
+    };
+
+    /**
+     * @brief Class constructor, the PPU starts at the beginning of a frame.
+     *
+     * @param memory Game Boy memory, holding the VRAM, the OAM and the LCD registers.
+     * @param scheduler System scheduler, running the mode changes.
+     */
+    PPU(Memory& memory, Scheduler& scheduler);
+    ~PPU();
+    /**
+     * @brief Gives the last rendered screen content, when no output buffer is set.
+     *
+     * @return The framebuffer, complete once frame_count() changed. White while an output buffer is set.
+     */
+    const Framebuffer& framebuffer() const { return output.framebuffer(); }
+    /**
+     * @brief Draws the frames straight into a buffer of the embedder, instead of the internal framebuffer.
+     *
+     * Each line is written once, in the requested format, when it is complete. Should be called between two frames,
+     * it otherwise takes effect from the next line. The internal framebuffer is freed meanwhile.
+     *
+     * @param pixels The buffer, holding SCREEN_HEIGHT rows. nullptr to draw into the internal framebuffer again.
+     * @param format Format of the pixels.
+     * @param stride Distance between the starts of two rows, in bytes.
+     * @throws std::runtime_error if the stride is smaller than a row.
+     */
+    void set_output(uint8_t* pixels, PixelFormat format, size_t stride);
+    /**
+     * @brief Also draws the frames in 8-bit gray (PixelFormat::Gray8) into a second buffer, whatever the output.
+     *
+     * Should be called between two frames, it otherwise takes effect from the next line.
+     *
+     * @param pixels The buffer, holding SCREEN_HEIGHT rows of SCREEN_WIDTH bytes. nullptr to stop writing it.
+     */
+    void set_gray_output(uint8_t* pixels);
+    /**
+     * @brief Gives the number of frames completed since power on, i.e., of VBlank periods entered.
+     *
+     * @return The frame counter.
+     */
+    uint64_t frame_count() const { return frames; }
+    /**
+     * @brief Gives the hash of the last drawn frame, computed line by line while drawing it.
+     *
+     * The hash covers the shades of the pixels, so it does not depend on the renderer or on the output format.
+     *
+     * @return The CRC32C of the shades (0-3) of the frame, row by row. 0 before the first frame.
+     */
+    uint32_t frame_hash() const { return last_frame_hash; }
+    /**
+     * @brief Tells if the last drawn frame looks the same as the one drawn before it, e.g. on a paused screen.
+     *
+     * @return true if both frames have the same hash.
+     */
+    bool frame_repeated() const { return repeated_frame; }
+    /**
+     * @brief Gives the memory owned by the PPU outside of the object itself.
+     *
+     * @return The size in bytes of the internal framebuffer and of the caches of the drawing, while they are
+     * allocated, and of the render thread.
+     */
+    size_t heap_bytes() const;
+    /**
+     * @brief Selects the renderer, which takes over at the start of the next frame.
+     *
+     * @param renderer The renderer to use.
+     */
+    void set_renderer(Renderer renderer) { next_renderer = renderer; }
+    /**
+     * @brief Gives the renderer drawing the current frame.
+     *
+     * @return The renderer in use.
+     */
+    Renderer renderer() const { return current_renderer; }
+    /**
+     * @brief Enables or disables the drawing of the frames, from the next frame on.
+     *
+     * A skipped frame leaves the framebuffer as it was, but everything else is unchanged: LY, the STAT modes and
+     * their durations, the interrupts and the VRAM/OAM access windows behave as if it was drawn. The caches of the
+     * drawing are freed on the first skipped frame, and allocated again by the next drawn one.
+     *
+     * @param skip true to skip the frames, except the ones asked for with render_next_frames().
+     */
+    void set_render_skip(bool skip)
+    {
+        skip_rendering = skip;
+        release_caches = skip;
+    }
+    /**
+     * @brief Draws the next frames even if render skipping is enabled.
+     *
+     * @param count Number of frames to draw, starting with the next one.
+     */
+    void render_next_frames(uint32_t count) { frames_to_render = count; }
+    /**
+     * @brief Tells if the current frame is being drawn.
+     *
+     * @return false if the frame is skipped, the framebuffer then still holds the last drawn frame.
+     */
+    bool rendering() const { return render_frame; }
+    /**
+     * @brief Moves the drawing of the scanline renderer to a render thread, or back to the emulation thread.
+     *
+     * The frames are the same either way. The frames drawn by the pixel FIFO renderer stay on the emulation thread.
+     *
+     * @param enabled true to draw on a render thread.
+     */
+    void set_render_thread(bool enabled);
+    /**
+     * @brief Waits for the lines sent to the render thread to be drawn, so that the output can be read. Done on
+     * entering VBlank, only needed when the emulation stopped in the middle of a frame.
+     */
+    void finish_drawing();
+
+private:
+    Memory& memory; /**< Reference to the Game Boy memory. */
+    Scheduler& scheduler; /**< System scheduler. */
+    FrameOutput output; /**< Destination of the drawn lines. */
+    LineRenderer lines; /**< Draws the lines of the scanline renderer, and caches the tiles and objects for the FIFO. */
+    std::unique_ptr<RenderThread> render_thread; /**< Thread drawing the scanline renderer lines, if enabled. */
+    /**< Shades of the line being drawn by the pixel FIFO renderer, written to output once complete. */
+    std::array<uint8_t, SCREEN_WIDTH> line_shades {};
+    uint32_t last_frame_hash {}; /**< Hash of the last drawn frame. */
+    bool repeated_frame { false }; /**< true if the last drawn frame has the same hash as the one before. */
+    uint64_t frames {}; /**< Number of completed frames. */
+    uint16_t dot {}; /**< Position in the current line, in dots, of the step running or scheduled next. */
+    uint64_t drawing_start {}; /**< System cycle the drawing of the current line started at. */
+    uint8_t ly {}; /**< Current line. */
+    uint8_t window_line {}; /**< Line of the window to draw next, only advanced on lines showing the window. */
+    Mode mode { Mode::OamScan }; /**< Current mode. */
+    bool lcd_enabled { true }; /**< false while LCDC bit 7 is cleared: the PPU is idle and LY stays at 0. */
+    bool stat_line { false }; /**< State of the STAT interrupt line, the interrupt fires on its rising edge. */
+    bool window_y_reached { false }; /**< true once LY matched WY during the frame, the window may then show. */
+    Renderer current_renderer { Renderer::Scanline }; /**< Renderer drawing the current frame. */
+    Renderer next_renderer { Renderer::Scanline }; /**< Renderer taking over at the next frame. */
+    bool skip_rendering { false }; /**< true to skip drawing the frames, see set_render_skip(). */
+    uint32_t frames_to_render {}; /**< Next frames drawn whatever skip_rendering, see render_next_frames(). */
+    bool release_caches { false }; /**< true to free the caches of the drawing on the next skipped frame. */
+    bool render_frame { true }; /**< true if the current frame is drawn. */
+
+    const LineRenderer::LineObjects* line_objects { nullptr }; /**< Objects of the line drawn by the pixel FIFO. */
+
+    /**
+     * @brief Step of the background fetcher of the pixel FIFO renderer, each one lasting 2 dots except Push.
+     */
+    enum class FetchStep : uint8_t {
+        Tile, /**< Reads the tile index from the tile map. */
+        DataLow, /**< Reads the low bitplane of the tile row. */
+        DataHigh, /**< Reads the high bitplane of the tile row. */
+        Push, /**< Waits for the background FIFO to be empty, then fills it with the 8 pixels of the row. */
+    };
+
+    /**
+     * @brief Object pixel waiting in the object FIFO.
+     */
+    struct ObjectPixel {
+        uint8_t color; /**< Color index, 0 for transparent. */
+        uint8_t flags; /**< Attribute flags of the object (palette, BG priority). */
+    };
+
+    std::array<uint8_t, 8> bg_fifo {}; /**< Background color indices waiting to be shifted out. */
+    uint8_t bg_fifo_head {}; /**< Index of the next background pixel. */
+    uint8_t bg_fifo_size {}; /**< Number of background pixels waiting. */
+    std::array<ObjectPixel, 8> object_fifo {}; /**< Object pixels, the slot k being mixed with the k-th next pixel. */
+    uint8_t object_fifo_head {}; /**< Index of the slot of the next pixel. */
+    FetchStep fetch_step { FetchStep::Tile }; /**< Current step of the background fetcher. */
+    uint8_t fetch_dots {}; /**< Dots spent in the current fetcher step. */
+    uint8_t fetch_x {}; /**< Tile column fetched next, relative to the scroll or to the window. */
+    uint8_t fetch_tile {}; /**< Tile index read by the fetcher. */
+    uint8_t fetch_low {}; /**< Low bitplane read by the fetcher. */
+    uint8_t fetch_high {}; /**< High bitplane read by the fetcher. */
+    uint8_t lx {}; /**< Number of pixels output on the current line. */
+    uint8_t discard {}; /**< Pixels left to drop at the start of the line, for the fine horizontal scroll. */
+    uint8_t stall {}; /**< Dots left before the pixel output resumes after an object fetch. */
+    uint16_t objects_fetched {}; /**< Bit i is set once the i-th object of the line has been fetched. */
+    bool window_active { false }; /**< true once the fetcher switched to the window on the current line. */
+
+    /**
+     * @brief Switches the PPU off or on when LCDC bit 7 changed. Handler of Event::LcdControl.
+     */
+    void check_lcd_control();
+    /**
+     * @brief Makes the mode change that is due, or steps the pixel FIFO renderer. Handler of Event::PpuMode.
+     */
+    void step();
+    /**
+     * @brief Schedules the next mode change, or the next dot while the pixel FIFO renderer draws.
+     */
+    void schedule_step();
+    /**
+     * @brief Starts a new frame: applies the renderer and render skip settings, and resets the window.
+     */
+    void start_frame();
+    /**
+     * @brief Ends the OAM scan: selects the objects of the line and enters the drawing mode.
+     */
+    void start_drawing();
+    /**
+     * @brief Changes the current mode and updates STAT accordingly.
+     *
+     * @param new_mode The new mode.
+     */
+    void set_mode(Mode new_mode);
+    /**
+     * @brief Moves on to the next line, entering VBlank or starting a new frame when needed.
+     */
+    void next_line();
+    /**
+     * @brief Updates the LY=LYC flag of STAT and raises the STAT interrupt on a rising edge of its line.
+     */
+    void update_stat();
+    /**
+     * @brief Draws the current line, here or on the render thread, with the LCD register writes made during the
+     * drawing applied from the pixel being output when they happened. Used by the scanline renderer.
+     */
+    void render_line();
+    /**
+     * @brief Resets the fetcher and the FIFOs at the start of the drawing. Used by the pixel FIFO renderer.
+     */
+    void start_fifo_line();
+    /**
+     * @brief Advances the drawing by one dot, entering HBlank once the 160 pixels are out. Used by the pixel FIFO
+     * renderer.
+     */
+    void step_fifo();
+    /**
+     * @brief Mixes the next background and object pixels and writes the resulting shade into line_shades.
+     *
+     * @param lcdc Value of LCDC.
+     * @param bg_color Color index of the background pixel.
+     */
+    void mix_pixel(uint8_t lcdc, uint8_t bg_color);
+    /**
+     * @brief Advances the background fetcher by one dot.
+     */
+    void step_fetcher();
+    /**
+     * @brief Fetches an object row and merges it into the object FIFO.
+     *
+     * @param object OAM index of the object.
+     */
+    void fetch_object(uint8_t object);
 };
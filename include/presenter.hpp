@@ -0,0 +1,68 @@
+#pragma once
+
+#include "scaler.hpp"
+#include "triple_buffer.hpp"
+#include <string>
+
+struct SDL_Window;
+struct SDL_Renderer;
+struct SDL_Texture;
+
+/**
+ * @brief SDL2 window showing the frames of an emulation running on another thread. Only built with GAMEBOY_SDL.
+ *
+ * The frames come through a triple buffer, in PixelFormat::Rgba8888. Each new one is upscaled with a pixel art filter
+ * (see ScaleFilter) into a streaming texture, which is scaled to the window. Waiting for the vertical sync and for
+ * the compositor only blocks the thread of the presenter, which has to be the one that created it (the main thread
+ * on most platforms).
+ */
+class Presenter {
+public:
+    static constexpr int DEFAULT_SCALE = 4; /**< Initial size of the window, in window pixels per screen pixel. */
+
+    /**
+     * @brief Opens the window.
+     *
+     * @param title Title of the window.
+     * @param filter Upscaling filter applied to the frames before they are uploaded.
+     * @param scale Initial size of the window, in window pixels per screen pixel.
+     * @throws std::runtime_error if SDL, the window, its renderer or the texture could not be created.
+     */
+    Presenter(const std::string& title, ScaleFilter filter = ScaleFilter::None, int scale = DEFAULT_SCALE);
+    /**
+     * @brief Closes the window.
+     */
+    ~Presenter();
+
+    Presenter(const Presenter&) = delete;
+    Presenter& operator=(const Presenter&) = delete;
+
+    /**
+     * @brief Shows the frames as they are published, until the window is closed.
+     *
+     * @param frames Frames of the emulation, PPU::SCREEN_HEIGHT rows of PPU::SCREEN_WIDTH pixels each.
+     */
+    void run(TripleBuffer& frames);
+    /**
+     * @brief Makes run() return, as if the window was closed. Can be called from any thread.
+     */
+    void request_close();
+
+private:
+    SDL_Window* window { nullptr }; /**< The window. */
+    SDL_Renderer* renderer { nullptr }; /**< Renderer of the window, synchronized with the vertical sync. */
+    SDL_Texture* texture { nullptr }; /**< Streaming texture holding the last frame, upscaled. */
+    ScaleFilter filter; /**< Upscaling filter applied to the frames. */
+    bool vsync { false }; /**< true if presenting waits for the vertical sync. */
+
+    /**
+     * @brief Destroys the SDL objects created so far and quits SDL.
+     */
+    void close();
+    /**
+     * @brief Upscales a frame into the texture.
+     *
+     * @param frame The frame.
+     */
+    void upload(const uint8_t* frame);
+};
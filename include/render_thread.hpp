@@ -0,0 +1,101 @@
+#pragma once
+
+#include "memory.hpp"
+#include "ppu.hpp"
+#include "video_log.hpp"
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <thread>
+
+/**
+ * @brief Thread drawing the lines of the scanline renderer, so that the pixels are computed off the emulation thread.
+ *
+ * The render thread keeps its own copy of the video memory, updated from a log of the writes the emulation thread
+ * makes to the VRAM, the OAM and the LCD registers. Each line is queued in the same log at the point it would have
+ * been drawn on the emulation thread, so it is drawn from the same memory content and the frames are bit-identical.
+ */
+class RenderThread {
+public:
+    /**
+     * @brief Copies the video memory, starts logging its writes and starts the thread.
+     *
+     * @param memory Memory of the emulation thread.
+     * @param output Destination of the lines. Only the render thread writes it until wait() returns.
+     */
+    RenderThread(Memory& memory, PPU::FrameOutput& output);
+    /**
+     * @brief Draws the lines queued so far, stops the thread and the logging.
+     */
+    ~RenderThread();
+
+    RenderThread(const RenderThread&) = delete;
+    RenderThread& operator=(const RenderThread&) = delete;
+
+    /**
+     * @brief Queues a line to draw. See PPU::LineRenderer::draw_line().
+     *
+     * @param ly Line to draw.
+     * @param window_line Line of the window to draw, if WY was reached during the frame.
+     * @param writes Register writes made while the line was drawn, by increasing x.
+     */
+    void draw_line(
+        uint8_t ly, std::optional<uint8_t> window_line, std::span<const PPU::LineRenderer::RegisterWrite> writes)
+    {
+        for (const PPU::LineRenderer::RegisterWrite& write : writes)
+            log.push({ 0, write.index, write.value, VideoLog::Kind::RegisterWrite, false, 0, write.old_value, write.x },
+                false);
+        log.push({ 0, ly, 0, VideoLog::Kind::Line, window_line.has_value(), window_line.value_or(0), 0, 0 }, true);
+    }
+    /**
+     * @brief Waits for the queued lines to be drawn.
+     */
+    void wait() { log.wait_until_handled(); }
+    /**
+     * @brief Gives the memory used by the render thread, waiting for the queued lines so that the renderer is idle.
+     *
+     * @return The size in bytes of this object, which the PPU allocates, and of the caches of its renderer.
+     */
+    size_t heap_bytes()
+    {
+        wait();
+        return sizeof(RenderThread) + renderer.heap_bytes();
+    }
+    /**
+     * @brief Frees the caches of the renderer once the queued lines are drawn. See PPU::LineRenderer::release_caches().
+     */
+    void release_caches()
+    {
+        wait();
+        renderer.release_caches();
+    }
+
+private:
+    Memory& memory; /**< Memory of the emulation thread, logging its writes. */
+    PPU::FrameOutput& output; /**< Destination of the lines. */
+    VideoLog log; /**< Writes and lines to replay. */
+    std::array<uint8_t, 0x2000> vram; /**< Copy of the VRAM. */
+    std::array<uint8_t, 0xa0> oam; /**< Copy of the OAM. */
+    /**< Copy of the LCD registers. */
+    std::array<uint8_t, Memory::LCD_REGISTERS_END - Memory::LCD_REGISTERS_ADDR + 1> lcd_registers;
+    std::array<uint64_t, Memory::TILE_ROWS / 64> stale_tile_rows; /**< Tile rows written since they were decoded. */
+    uint32_t oam_writes {}; /**< Number of writes to the copy of the OAM. */
+    PPU::LineRenderer renderer; /**< Draws the lines from the copies. */
+    /**< Register writes made while the next line was drawn. */
+    std::array<PPU::LineRenderer::RegisterWrite, Memory::LCD_WRITES_KEPT> line_writes;
+    size_t line_write_count {}; /**< Number of writes in line_writes. */
+    std::thread thread; /**< The render thread. */
+
+    /**
+     * @brief Body of the render thread, replaying the log.
+     */
+    void run();
+    /**
+     * @brief Applies a logged write to the copy of the video memory.
+     *
+     * @param address Written address.
+     * @param value Written value.
+     */
+    void apply_write(uint16_t address, uint8_t value);
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/**
+ * @brief Battery-backed cartridge RAM, stored in a memory-mapped .sav file.
+ *
+ * The mapping is used directly as the SRAM backing store: the emulator writes into it like any other array and only
+ * flags the touched page. A background thread, shared by all the open save files, msyncs the dirty pages of each one
+ * every flush interval, and the remaining ones are flushed when the save file is destroyed, so the emulation thread
+ * never waits on the disk.
+ */
+class SaveFile {
+public:
+    /**
+     * @brief Opens (or creates) the save file, maps it in memory and registers it with the background flusher.
+     *
+     * @param path Path of the .sav file.
+     * @param size Size of the cartridge RAM in bytes. A smaller file is grown to it, a larger one is left as is and
+     * only its first size bytes are used.
+     * @param flush_interval Delay between two background flushes. Zero disables them, saving only on exit.
+     * @throws std::runtime_error if the file could not be opened, resized or mapped.
+     */
+    SaveFile(const std::string& path, size_t size, std::chrono::milliseconds flush_interval);
+    /**
+     * @brief Unregisters the file from the background flusher, flushes the remaining dirty pages and unmaps it.
+     */
+    ~SaveFile();
+
+    SaveFile(const SaveFile&) = delete;
+    SaveFile& operator=(const SaveFile&) = delete;
+
+    /**
+     * @brief Gives the start of the mapped cartridge RAM.
+     *
+     * @return Pointer to the first byte of the mapping.
+     */
+    uint8_t* data() { return mapping; }
+    /**
+     * @brief Gives the size of the mapped cartridge RAM.
+     *
+     * @return The size in bytes.
+     */
+    size_t size() const { return mapping_size; }
+    /**
+     * @brief Flags the page containing a byte as needing to be written back. Called on every SRAM write.
+     *
+     * @param offset Offset of the written byte in the cartridge RAM.
+     */
+    void mark_dirty(size_t offset)
+    {
+        dirty_pages[offset >> page_shift].store(true, std::memory_order_relaxed);
+    }
+    /**
+     * @brief Changes the delay between two background flushes.
+     *
+     * @param interval New delay. Zero disables periodic flushing.
+     */
+    void set_flush_interval(std::chrono::milliseconds interval);
+    /**
+     * @brief Synchronously writes every dirty page back to the file.
+     */
+    void flush();
+
+private:
+    int fd { -1 }; /**< File descriptor of the .sav file. */
+    uint8_t* mapping { nullptr }; /**< Start of the shared mapping of the file. */
+    size_t mapping_size {}; /**< Size of the mapping in bytes. */
+    unsigned page_shift {}; /**< log2 of the system page size, the granularity of msync. */
+    std::unique_ptr<std::atomic<bool>[]> dirty_pages; /**< One flag per page, set on write and cleared on flush. */
+    size_t page_count {}; /**< Number of pages covered by the mapping. */
+
+    std::mutex flush_mutex; /**< Serializes flushes from the flusher thread and from flush() callers. */
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Pixel art upscaling filters, for the presentation of the frames.
+ */
+enum class ScaleFilter : uint8_t {
+    None, /**< Frame copied as is. */
+    Scale2x, /**< Scale2x (AdvMAME2x): each pixel becomes 2x2, the diagonal edges being followed instead of stepped. */
+    Scale3x, /**< Scale3x (AdvMAME3x): the same, each pixel becoming 3x3. */
+    /**
+     * Scale2x deciding the edges the same way, but blending the neighbor color with the pixel color (3:1) instead
+     * of copying it, in the spirit of hq2x. Gives smoother diagonals.
+     */
+    Smooth2x,
+};
+
+/**
+ * @brief Gives the size factor of a filter.
+ *
+ * @param filter The filter.
+ * @return The number of output pixels per input pixel, in each direction.
+ */
+constexpr int scale_factor(ScaleFilter filter)
+{
+    switch (filter) {
+    case ScaleFilter::Scale2x:
+    case ScaleFilter::Smooth2x:
+        return 2;
+    case ScaleFilter::Scale3x:
+        return 3;
+    default:
+        return 1;
+    }
+}
+
+/**
+ * @brief Upscales an image of 4-byte pixels (e.g. PixelFormat::Rgba8888), the colors being compared for equality.
+ *
+ * Uses SSE2 when the CPU supports it, and a pixel by pixel implementation otherwise. Both give the same result. The
+ * pixels outside the image are taken as copies of the edge pixels.
+ *
+ * @param pixels The image.
+ * @param width Width of the image, in pixels.
+ * @param height Height of the image, in pixels.
+ * @param stride Distance between the starts of two rows of the image, in bytes.
+ * @param filter The filter.
+ * @param output Receives the scaled image, scale_factor(filter) times larger in each direction.
+ * @param output_stride Distance between the starts of two rows of the output, in bytes.
+ */
+void scale_image(const uint8_t* pixels, size_t width, size_t height, size_t stride, ScaleFilter filter,
+    uint8_t* output, size_t output_stride);
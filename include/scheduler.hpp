@@ -0,0 +1,105 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+
+/**
+ * @brief Hardware events that can be scheduled at a given cycle.
+ */
+enum class Event : uint8_t {
+    OamDmaEnd, /**< End of the OAM DMA transfer, releasing the bus. */
+    LcdControl, /**< LCDC was written, the PPU checks if the LCD was switched on or off. */
+    LcdStat, /**< LYC or STAT was written, the PPU updates the LY=LYC flag and the STAT interrupt line. */
+    PpuMode, /**< Next PPU mode change, or next dot of the pixel FIFO renderer while it draws. */
+    Count, /**< Number of event types. */
+};
+
+/**
+ * @brief Keeps the system clock and calls back the components when the events they scheduled are due.
+ *
+ * Components schedule their next state change as an absolute cycle instead of checking their state every cycle, so
+ * the per-cycle cost of the scheduler is one increment and one comparison.
+ */
+class Scheduler {
+public:
+    static constexpr uint64_t NEVER = std::numeric_limits<uint64_t>::max(); /**< Deadline of an unscheduled event. */
+
+    /**
+     * @brief Class constructor, nothing is scheduled.
+     */
+    Scheduler() { deadlines.fill(NEVER); }
+    /**
+     * @brief Sets the function called when an event is due.
+     *
+     * @param event Event to handle.
+     * @param handler Function to call.
+     */
+    void set_handler(Event event, std::function<void()> handler)
+    {
+        handlers[static_cast<size_t>(event)] = std::move(handler);
+    }
+    /**
+     * @brief Schedules an event, replacing its previous deadline if it was already scheduled.
+     *
+     * @param event Event to schedule.
+     * @param delay Number of cycles from now after which the event is due.
+     */
+    void schedule(Event event, uint64_t delay)
+    {
+        deadlines[static_cast<size_t>(event)] = cycle + delay;
+        next_deadline = std::min(next_deadline, cycle + delay);
+    }
+    /**
+     * @brief Cancels a scheduled event.
+     *
+     * @param event Event to cancel.
+     */
+    void cancel(Event event) { deadlines[static_cast<size_t>(event)] = NEVER; }
+    /**
+     * @brief Checks if an event is scheduled.
+     *
+     * @param event Event to check.
+     * @return true if the event is pending, false otherwise.
+     */
+    bool is_scheduled(Event event) const { return deadlines[static_cast<size_t>(event)] != NEVER; }
+    /**
+     * @brief Gives the number of cycles elapsed since power on.
+     *
+     * @return The current cycle.
+     */
+    uint64_t now() const { return cycle; }
+    /**
+     * @brief Advances the clock by one cycle and runs the events that became due.
+     */
+    void tick()
+    {
+        if (++cycle >= next_deadline) [[unlikely]]
+            run_due_events();
+    }
+
+private:
+    uint64_t cycle {}; /**< Number of cycles elapsed since power on. */
+    uint64_t next_deadline { NEVER }; /**< Earliest deadline among the scheduled events. */
+    std::array<uint64_t, static_cast<size_t>(Event::Count)> deadlines; /**< Due cycle of each event. */
+    std::array<std::function<void()>, static_cast<size_t>(Event::Count)> handlers; /**< Callback of each event. */
+
+    /**
+     * @brief Runs the handlers of the due events and computes the next deadline.
+     */
+    void run_due_events()
+    {
+        next_deadline = NEVER;
+        for (size_t event = 0; event < deadlines.size(); ++event) {
+            if (deadlines[event] <= cycle) {
+                deadlines[event] = NEVER;
+                handlers[event]();
+            }
+        }
+        for (uint64_t deadline : deadlines)
+            next_deadline = std::min(next_deadline, deadline);
+    }
+};
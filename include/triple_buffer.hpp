@@ -0,0 +1,68 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Three frame buffers passing the frames from a producer thread to a consumer thread, without either of them
+ * ever waiting for the other.
+ *
+ * The producer draws into the back buffer and publishes it, which swaps it with the middle one. The consumer takes
+ * the middle buffer as its front buffer when a new frame was published since. A slow consumer thus only misses
+ * frames, and always gets the latest one.
+ */
+class TripleBuffer {
+public:
+    /**
+     * @brief Class constructor.
+     *
+     * @param size Size of each buffer, in bytes.
+     */
+    TripleBuffer(size_t size)
+    {
+        for (std::vector<uint8_t>& buffer : buffers)
+            buffer.resize(size);
+    }
+
+    /**
+     * @brief Gives the buffer to draw the next frame into. Called by the producer.
+     *
+     * @return The back buffer, changed by publish().
+     */
+    uint8_t* back() { return buffers[back_index].data(); }
+    /**
+     * @brief Publishes the frame drawn into the back buffer, which is replaced by another one. Called by the
+     * producer.
+     */
+    void publish() { back_index = middle.exchange(back_index | FRESH, std::memory_order_acq_rel) & INDEX; }
+    /**
+     * @brief Takes the last published frame as the front buffer, if there is a new one. Called by the consumer.
+     *
+     * @return true if the front buffer changed.
+     */
+    bool acquire()
+    {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH))
+            return false;
+        front_index = middle.exchange(front_index, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+    /**
+     * @brief Gives the frame to show. Called by the consumer.
+     *
+     * @return The front buffer, changed by acquire().
+     */
+    const uint8_t* front() const { return buffers[front_index].data(); }
+
+private:
+    static constexpr uint8_t INDEX = 0x03; /**< Bits of middle holding the buffer index. */
+    static constexpr uint8_t FRESH = 0x04; /**< Bit of middle set when it holds a frame the consumer did not take. */
+
+    std::array<std::vector<uint8_t>, 3> buffers; /**< The three buffers. */
+    uint8_t back_index { 0 }; /**< Buffer of the producer. */
+    uint8_t front_index { 1 }; /**< Buffer of the consumer. */
+    alignas(64) std::atomic<uint8_t> middle { 2 }; /**< Buffer between the two, with the FRESH bit. */
+};
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+/**
+ * @brief Single-producer single-consumer queue of the video memory writes and the lines to draw, from the emulation
+ * thread to the render thread.
+ *
+ * The emulation thread logs the writes to the VRAM, the OAM and the LCD registers as they happen, and asks for a line
+ * at the point the scanline renderer would have drawn it. Replaying the entries in order on a copy of the video memory
+ * thus draws the same lines. Writes are only queued, the render thread is woken up for the lines.
+ */
+class VideoLog {
+public:
+    static constexpr uint32_t CAPACITY = 1 << 12; /**< Number of entries the queue holds, a power of 2. */
+
+    /**
+     * @brief Kinds of entries.
+     */
+    enum class Kind : uint8_t {
+        Write, /**< Write of value at address. */
+        RegisterWrite, /**< LCD register write made while the next line was drawn, see PPU::LineRenderer. */
+        Line, /**< Line to draw, address being LY. */
+    };
+
+    /**
+     * @brief Entry of the log.
+     */
+    struct Entry {
+        uint64_t cycle; /**< System cycle of a write. */
+        uint16_t address; /**< Written address, or the line to draw. For a register write, index of the register. */
+        uint8_t value; /**< Written value. */
+        Kind kind; /**< Kind of the entry. */
+        bool window; /**< For a line, true if the window can show on it (WY reached). */
+        uint8_t window_line; /**< For a line the window can show on, line of the window to draw. */
+        uint8_t old_value; /**< For a register write, value of the register before it. */
+        uint8_t x; /**< For a register write, first pixel of the line drawn with the new value. */
+    };
+
+    /**
+     * @brief Logs a write. Called by the emulation thread.
+     *
+     * @param cycle System cycle of the write.
+     * @param address Written address.
+     * @param value Written value.
+     */
+    void write(uint64_t cycle, uint16_t address, uint8_t value)
+    {
+        push({ cycle, address, value, Kind::Write, false, 0, 0, 0 }, false);
+    }
+    /**
+     * @brief Adds an entry to the log, waiting for room if it is full. Called by the emulation thread.
+     *
+     * @param entry The entry.
+     * @param wake true to wake the render thread up, so that it handles the entries logged so far.
+     */
+    void push(const Entry& entry, bool wake)
+    {
+        uint32_t index = tail.load(std::memory_order_relaxed);
+        while (index - head.load(std::memory_order_acquire) == CAPACITY) {
+            notify();
+            std::this_thread::yield();
+        }
+        entries[index % CAPACITY] = entry;
+        tail.store(index + 1, std::memory_order_release);
+        if (wake)
+            notify();
+    }
+    /**
+     * @brief Waits for the render thread to handle all the entries logged so far. Called by the emulation thread.
+     */
+    void wait_until_handled();
+    /**
+     * @brief Asks the render thread to stop once the log is empty. Called by the emulation thread.
+     */
+    void close();
+    /**
+     * @brief Waits for entries to handle. Called by the render thread.
+     *
+     * @return false once the log is closed and empty, true otherwise.
+     */
+    bool wait_for_entries();
+    /**
+     * @brief Gives the oldest entry not handled yet. Called by the render thread.
+     *
+     * @return The entry, or nullptr if the log is empty.
+     */
+    const Entry* front() const
+    {
+        uint32_t index = head.load(std::memory_order_relaxed);
+        return index == tail.load(std::memory_order_acquire) ? nullptr : &entries[index % CAPACITY];
+    }
+    /**
+     * @brief Removes the entry given by front() once handled. Called by the render thread.
+     */
+    void pop();
+
+private:
+    std::array<Entry, CAPACITY> entries {}; /**< Ring buffer of the entries. */
+    alignas(64) std::atomic<uint32_t> tail {}; /**< Number of entries pushed, written by the emulation thread. */
+    alignas(64) std::atomic<uint32_t> head {}; /**< Number of entries handled, written by the render thread. */
+    std::atomic<uint32_t> wakeups {}; /**< Changed to wake the render thread up. */
+    std::atomic<bool> closed { false }; /**< true once the render thread has to stop. */
+
+    /**
+     * @brief Wakes the render thread up.
+     */
+    void notify()
+    {
+        wakeups.fetch_add(1, std::memory_order_release);
+        wakeups.notify_one();
+    }
+};
@@ -0,0 +1,123 @@
+#include "cartridge.hpp"
+#include "hash.hpp"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+/**
+ * @brief Gives the size of the cartridge RAM from the cartridge header.
+ *
+ * @param cartridge_type Cartridge type byte (0x147).
+ * @param ram_size_code RAM size byte (0x149).
+ * @return The size of the cartridge RAM in bytes, 0 if there is none.
+ */
+size_t cartridge_ram_size(uint8_t cartridge_type, uint8_t ram_size_code)
+{
+    if (cartridge_type == 0x05 or cartridge_type == 0x06)
+        return 0x200; // MBC2 built-in RAM, 512 half-bytes
+    switch (ram_size_code) {
+    case 0x01:
+        return 0x800;
+    case 0x02:
+        return 0x2000;
+    case 0x03:
+        return 0x8000;
+    case 0x04:
+        return 0x20000;
+    case 0x05:
+        return 0x10000;
+    default:
+        return 0;
+    }
+}
+
+/**
+ * @brief Checks if a cartridge keeps its RAM powered by a battery.
+ *
+ * @param cartridge_type Cartridge type byte (0x147).
+ * @return true if the cartridge RAM is battery-backed, false otherwise.
+ */
+bool has_battery(uint8_t cartridge_type)
+{
+    switch (cartridge_type) {
+    case 0x03: // MBC1+RAM+BATTERY
+    case 0x06: // MBC2+BATTERY
+    case 0x09: // ROM+RAM+BATTERY
+    case 0x0d: // MMM01+RAM+BATTERY
+    case 0x0f: // MBC3+TIMER+BATTERY
+    case 0x10: // MBC3+TIMER+RAM+BATTERY
+    case 0x13: // MBC3+RAM+BATTERY
+    case 0x1b: // MBC5+RAM+BATTERY
+    case 0x1e: // MBC5+RUMBLE+RAM+BATTERY
+    case 0x22: // MBC7+SENSOR+RUMBLE+RAM+BATTERY
+    case 0xff: // HuC1+RAM+BATTERY
+        return true;
+    default:
+        return false;
+    }
+}
+
+} // namespace
+
+CartridgeInfo parse_cartridge(const std::vector<uint8_t>& rom)
+{
+    CartridgeInfo info;
+    info.hash = crc32c(rom.data(), rom.size());
+    if (rom.size() < 0x150)
+        return info;
+
+    info.cgb_flag = rom[0x143];
+    // The last byte of the title area is the CGB flag on games aware of the CGB.
+    size_t title_end = info.cgb_flag & 0x80 ? 0x143 : 0x144;
+    for (size_t addr = 0x134; addr < title_end and rom[addr] != 0x00; ++addr)
+        info.title.push_back(static_cast<char>(rom[addr]));
+
+    info.type = rom[0x147];
+    info.rom_size = rom[0x148] <= 0x08 ? static_cast<size_t>(0x8000) << rom[0x148] : 0;
+    info.ram_size = cartridge_ram_size(rom[0x147], rom[0x149]);
+    info.has_battery = has_battery(rom[0x147]);
+
+    uint8_t header_checksum = 0;
+    for (size_t addr = 0x134; addr <= 0x14c; ++addr)
+        header_checksum = header_checksum - rom[addr] - 1;
+    info.header_checksum = rom[0x14d];
+    info.header_checksum_valid = header_checksum == rom[0x14d];
+
+    uint32_t sum = 0;
+    for (uint8_t byte : rom)
+        sum += byte;
+    sum -= rom[0x14e] + rom[0x14f];
+    info.global_checksum = static_cast<uint16_t>(rom[0x14e] << 8 | rom[0x14f]);
+    info.global_checksum_valid = static_cast<uint16_t>(sum) == info.global_checksum;
+
+    return info;
+}
+
+std::shared_ptr<const std::vector<uint8_t>> share_rom(std::vector<uint8_t>&& image, uint32_t hash)
+{
+    using SharedRom = std::shared_ptr<const std::vector<uint8_t>>;
+    static std::mutex mutex;
+    static std::unordered_multimap<uint32_t, std::weak_ptr<const std::vector<uint8_t>>> images;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto [first, last] = images.equal_range(hash);
+    for (auto it = first; it != last;) {
+        SharedRom shared = it->second.lock();
+        if (!shared) {
+            it = images.erase(it);
+            continue;
+        }
+        if (*shared == image)
+            return shared;
+        ++it;
+    }
+
+    SharedRom shared = std::make_shared<const std::vector<uint8_t>>(std::move(image));
+    images.emplace(hash, shared);
+    return shared;
+}
@@ -1,13 +1,33 @@
 #include "cpu.hpp"
 #include "memory.hpp"
 #include "registers.hpp"
+#include <charconv>
 #include <cstdint>
-#include <format>
 #include <functional>
 #include <iostream>
+#include <stdexcept>
+#include <string>
+
+const CPU::InstructionTables& CPU::shared_tables()
+{
+    static const InstructionTables tables = setup_tables();
+    return tables;
+}
+
+const std::array<CPU::Reg8Getter, 8> CPU::reg8_getters = {
+    [](CPU& cpu) -> uint8_t& { return cpu.regs.b(); },
+    [](CPU& cpu) -> uint8_t& { return cpu.regs.c(); },
+    [](CPU& cpu) -> uint8_t& { return cpu.regs.d(); },
+    [](CPU& cpu) -> uint8_t& { return cpu.regs.e(); },
+    [](CPU& cpu) -> uint8_t& { return cpu.regs.h(); },
+    [](CPU& cpu) -> uint8_t& { return cpu.regs.l(); },
+    nullptr, // (HL) is not a register, the operations on it go through the memory bus.
+    [](CPU& cpu) -> uint8_t& { return cpu.regs.a(); }
+};
 
 CPU::CPU(Memory& memory)
     : memory(memory)
+    , tables(shared_tables())
 {
     regs.af.set(0x01b0);
     regs.bc.set(0x0013);
@@ -15,8 +35,6 @@ CPU::CPU(Memory& memory)
     regs.hl.set(0x014d);
     regs.pc = 0x0100;
     regs.sp = 0xfffe;
-
-    setup_tables();
 }
 
 void CPU::cycle()
@@ -37,13 +55,13 @@ void CPU::cycle()
 
     if (cycles_left == 0) {
         if (halt_bug) {
-            opcode = memory.read_byte(regs.pc);
+            opcode = memory.fetch_opcode(regs.pc);
             halt_bug = false;
         } else {
-            opcode = memory.read_byte(regs.pc++);
+            opcode = memory.fetch_opcode(regs.pc++);
         }
         decode_and_execute();
-        cycles_left = instruction_cycles[opcode] - 1;
+        cycles_left = tables.instruction_cycles[opcode] - 1;
     } else {
         --cycles_left;
     }
@@ -60,7 +78,7 @@ void CPU::cycle()
 
 bool CPU::interrupt_pending()
 {
-    return (memory.read_byte(Memory::IE_ADDR) & memory.read_byte(Memory::IF_ADDR)) != 0x0;
+    return (memory.interrupt_enable() & memory.io_register(Memory::IF_ADDR)) != 0x0;
 }
 
 void CPU::handle_interrupts()
@@ -68,8 +86,8 @@ void CPU::handle_interrupts()
     if (!ime)
         return;
 
-    uint8_t ie = memory.read_byte(Memory::IE_ADDR);
-    uint8_t iflag = memory.read_byte(Memory::IF_ADDR);
+    uint8_t ie = memory.interrupt_enable();
+    uint8_t iflag = memory.io_register(Memory::IF_ADDR);
     uint8_t triggered = ie & iflag;
 
     if (triggered == 0)
@@ -80,12 +98,12 @@ void CPU::handle_interrupts()
             ime = false;
 
             iflag &= ~(1 << i);
-            memory.write_byte(Memory::IF_ADDR, iflag);
+            memory.set_io_register(Memory::IF_ADDR, iflag);
 
             uint16_t pc = regs.pc;
             regs.sp -= 2;
-            memory.write_byte(regs.sp, lsb(pc));
-            memory.write_byte(regs.sp + 1, msb(pc));
+            memory.write8(regs.sp, lsb(pc));
+            memory.write8(regs.sp + 1, msb(pc));
 
             regs.pc = 0x40 + i * 0x08;
 
@@ -101,11 +119,10 @@ void CPU::handle_timers()
     total_cycles++;
 
     if ((total_cycles & 0xFF) == 0) {
-        uint8_t div = memory.read_byte(0xFF04);
-        memory.write_byte(0xFF04, div + 1);
+        memory.set_io_register(0xFF04, memory.io_register(0xFF04) + 1);
     }
 
-    uint8_t tac = memory.read_byte(0xFF07);
+    uint8_t tac = memory.io_register(0xFF07);
     if (tac & 0x04) { // Timer enabled
         uint16_t mask;
         switch (tac & 0x03) {
@@ -124,13 +141,12 @@ void CPU::handle_timers()
         }
 
         if ((total_cycles & mask) == 0) {
-            uint8_t tima = memory.read_byte(0xFF05);
+            uint8_t tima = memory.io_register(0xFF05);
             if (tima == 0xFF) {
-                memory.write_byte(0xFF05, memory.read_byte(0xFF06));
-                uint8_t iflag = memory.read_byte(0xFF0F);
-                memory.write_byte(0xFF0F, iflag | 0x04);
+                memory.set_io_register(0xFF05, memory.io_register(0xFF06));
+                memory.request_interrupt(Memory::INTERRUPT_TIMER);
             } else {
-                memory.write_byte(0xFF05, tima + 1);
+                memory.set_io_register(0xFF05, tima + 1);
             }
         }
     }
@@ -138,183 +154,172 @@ void CPU::handle_timers()
 
 void CPU::check_serial_output()
 {
-    uint8_t sc = memory.read_byte(0xFF02);
+    uint8_t sc = memory.io_register(0xFF02);
     if (sc & 0x80) {
-        uint8_t sb = memory.read_byte(0xFF01);
+        uint8_t sb = memory.io_register(0xFF01);
         char c = static_cast<char>(sb);
         std::cout << c;
-        sc &= ~0x80;
-        memory.write_byte(0xFF02, sc);
-        uint8_t iflag = memory.read_byte(Memory::IF_ADDR);
-        memory.write_byte(Memory::IF_ADDR, iflag | 0x08);
+        memory.set_io_register(0xFF02, sc & ~0x80);
+        memory.request_interrupt(Memory::INTERRUPT_SERIAL);
     }
 }
 
-void CPU::setup_tables()
+CPU::InstructionTables CPU::setup_tables()
 {
-    std::array<std::function<uint8_t&()>, 8> reg8_getters = {
-        [&]() -> uint8_t& { return regs.b(); },
-        [&]() -> uint8_t& { return regs.c(); },
-        [&]() -> uint8_t& { return regs.d(); },
-        [&]() -> uint8_t& { return regs.e(); },
-        [&]() -> uint8_t& { return regs.h(); },
-        [&]() -> uint8_t& { return regs.l(); },
-        [&]() -> uint8_t& { return memory.at(regs.hl.get()); },
-        [&]() -> uint8_t& { return regs.a(); }
-    };
+    InstructionTables tables;
 
-    opcode_table[0xcb] = [this]() {
-        uint8_t cb_opcode = fetch_byte();
-        cbcode_table[cb_opcode]();
-        cycles_left += cb_instruction_cycles[cb_opcode];
+    tables.opcode_table[0xcb] = [](CPU& cpu) {
+        uint8_t cb_opcode = cpu.fetch_byte();
+        cpu.tables.cbcode_table[cb_opcode](cpu);
+        cpu.cycles_left += cpu.tables.cb_instruction_cycles[cb_opcode];
     };
-    instruction_cycles[0xcb] = 4;
-    opcode_table[0x00] = [this]() { op_nop(); };
-    instruction_cycles[0x00] = 4;
-    opcode_table[0x10] = [this]() { op_stop(); };
-    instruction_cycles[0x10] = 4;
-    opcode_table[0x76] = [this]() { op_halt(); };
-    instruction_cycles[0x76] = 4;
-    opcode_table[0xf3] = [this]() { op_di(); };
-    instruction_cycles[0xf3] = 4;
-    opcode_table[0xfb] = [this]() { op_ei(); };
-    instruction_cycles[0xfb] = 4;
-
-    opcode_table[0x03] = [this]() { inc_reg(regs.bc); };
-    instruction_cycles[0x03] = 8;
-    opcode_table[0x13] = [this]() { inc_reg(regs.de); };
-    instruction_cycles[0x13] = 8;
-    opcode_table[0x23] = [this]() { inc_reg(regs.hl); };
-    instruction_cycles[0x23] = 8;
-    opcode_table[0x33] = [this]() { op_inc_sp(); };
-    instruction_cycles[0x33] = 8;
+    tables.instruction_cycles[0xcb] = 4;
+    tables.opcode_table[0x00] = [](CPU& cpu) { cpu.op_nop(); };
+    tables.instruction_cycles[0x00] = 4;
+    tables.opcode_table[0x10] = [](CPU& cpu) { cpu.op_stop(); };
+    tables.instruction_cycles[0x10] = 4;
+    tables.opcode_table[0x76] = [](CPU& cpu) { cpu.op_halt(); };
+    tables.instruction_cycles[0x76] = 4;
+    tables.opcode_table[0xf3] = [](CPU& cpu) { cpu.op_di(); };
+    tables.instruction_cycles[0xf3] = 4;
+    tables.opcode_table[0xfb] = [](CPU& cpu) { cpu.op_ei(); };
+    tables.instruction_cycles[0xfb] = 4;
+
+    tables.opcode_table[0x03] = [](CPU& cpu) { cpu.inc_reg(cpu.regs.bc); };
+    tables.instruction_cycles[0x03] = 8;
+    tables.opcode_table[0x13] = [](CPU& cpu) { cpu.inc_reg(cpu.regs.de); };
+    tables.instruction_cycles[0x13] = 8;
+    tables.opcode_table[0x23] = [](CPU& cpu) { cpu.inc_reg(cpu.regs.hl); };
+    tables.instruction_cycles[0x23] = 8;
+    tables.opcode_table[0x33] = [](CPU& cpu) { cpu.op_inc_sp(); };
+    tables.instruction_cycles[0x33] = 8;
 
     for (uint8_t i = 0x0; i < 0x8; ++i) {
         uint8_t opcode = 0x04 + i * 0x08;
-        instruction_cycles[opcode] = 4;
+        tables.instruction_cycles[opcode] = 4;
         if (opcode == 0x34) {
-            opcode_table[opcode] = [this]() { op_inc__hl_(); };
-            instruction_cycles[opcode] += 8;
+            tables.opcode_table[opcode] = [](CPU& cpu) { cpu.op_inc__hl_(); };
+            tables.instruction_cycles[opcode] += 8;
         } else {
-            opcode_table[opcode] = [this, reg8_getters, i]() {
-                inc_reg(reg8_getters[i]());
+            tables.opcode_table[opcode] = [i](CPU& cpu) {
+                cpu.inc_reg(reg8_getters[i](cpu));
             };
         };
     }
 
-    opcode_table[0x0b] = [this]() { dec_reg(regs.bc); };
-    instruction_cycles[0x0b] = 8;
-    opcode_table[0x1b] = [this]() { dec_reg(regs.de); };
-    instruction_cycles[0x1b] = 8;
-    opcode_table[0x2b] = [this]() { dec_reg(regs.hl); };
-    instruction_cycles[0x2b] = 8;
-    opcode_table[0x3b] = [this]() { op_dec_sp(); };
-    instruction_cycles[0x3b] = 8;
+    tables.opcode_table[0x0b] = [](CPU& cpu) { cpu.dec_reg(cpu.regs.bc); };
+    tables.instruction_cycles[0x0b] = 8;
+    tables.opcode_table[0x1b] = [](CPU& cpu) { cpu.dec_reg(cpu.regs.de); };
+    tables.instruction_cycles[0x1b] = 8;
+    tables.opcode_table[0x2b] = [](CPU& cpu) { cpu.dec_reg(cpu.regs.hl); };
+    tables.instruction_cycles[0x2b] = 8;
+    tables.opcode_table[0x3b] = [](CPU& cpu) { cpu.op_dec_sp(); };
+    tables.instruction_cycles[0x3b] = 8;
 
     for (uint8_t i = 0x0; i < 0x8; ++i) {
         uint8_t opcode = 0x05 + i * 0x08;
-        instruction_cycles[opcode] = 4;
+        tables.instruction_cycles[opcode] = 4;
         if (opcode == 0x35) {
-            opcode_table[opcode] = [this]() { op_dec__hl_(); };
-            instruction_cycles[opcode] += 8;
+            tables.opcode_table[opcode] = [](CPU& cpu) { cpu.op_dec__hl_(); };
+            tables.instruction_cycles[opcode] += 8;
         } else {
-            opcode_table[opcode] = [this, reg8_getters, i]() {
-                dec_reg(reg8_getters[i]());
+            tables.opcode_table[opcode] = [i](CPU& cpu) {
+                cpu.dec_reg(reg8_getters[i](cpu));
             };
         };
     }
 
-    opcode_table[0x09] = [this]() { add_hl_reg16(regs.bc.get()); };
-    instruction_cycles[0x09] = 8;
-    opcode_table[0x19] = [this]() { add_hl_reg16(regs.de.get()); };
-    instruction_cycles[0x19] = 8;
-    opcode_table[0x29] = [this]() { add_hl_reg16(regs.hl.get()); };
-    instruction_cycles[0x29] = 8;
-    opcode_table[0x39] = [this]() { add_hl_reg16(regs.sp); };
-    instruction_cycles[0x39] = 8;
-
-    opcode_table[0xc3] = [this]() { op_jp_a16(); };
-    instruction_cycles[0xc3] = 16;
-    opcode_table[0xe9] = [this]() { op_jp__hl_(); };
-    instruction_cycles[0xe9] = 4;
-    opcode_table[0xc2] = [this]() { op_jp_nz_a16(); };
-    instruction_cycles[0xc2] = 12;
-    opcode_table[0xd2] = [this]() { op_jp_nc_a16(); };
-    instruction_cycles[0xd2] = 12;
-    opcode_table[0xca] = [this]() { op_jp_z_a16(); };
-    instruction_cycles[0xca] = 12;
-    opcode_table[0xda] = [this]() { op_jp_c_a16(); };
-    instruction_cycles[0xda] = 12;
-
-    opcode_table[0x18] = [this]() { op_jr_r8(); };
-    instruction_cycles[0x18] = 12;
-    opcode_table[0x20] = [this]() { op_jr_nz_r8(); };
-    instruction_cycles[0x20] = 12;
-    opcode_table[0x30] = [this]() { op_jr_nc_r8(); };
-    instruction_cycles[0x30] = 12;
-    opcode_table[0x28] = [this]() { op_jr_z_r8(); };
-    instruction_cycles[0x28] = 12;
-    opcode_table[0x38] = [this]() { op_jr_c_r8(); };
-    instruction_cycles[0x38] = 12;
-
-    opcode_table[0xcd] = [this]() { op_call_a16(); };
-    instruction_cycles[0xcd] = 24;
-    opcode_table[0xc4] = [this]() { op_call_nz_a16(); };
-    instruction_cycles[0xc4] = 12;
-    opcode_table[0xd4] = [this]() { op_call_nc_a16(); };
-    instruction_cycles[0xd4] = 12;
-    opcode_table[0xcc] = [this]() { op_call_z_a16(); };
-    instruction_cycles[0xcc] = 12;
-    opcode_table[0xdc] = [this]() { op_call_c_a16(); };
-    instruction_cycles[0xdc] = 12;
-
-    opcode_table[0xc9] = [this]() { op_ret(); };
-    instruction_cycles[0xc9] = 16;
-    opcode_table[0xd9] = [this]() { op_reti(); };
-    instruction_cycles[0xd9] = 16;
-    opcode_table[0xc0] = [this]() { op_ret_nz(); };
-    instruction_cycles[0xc0] = 8;
-    opcode_table[0xd0] = [this]() { op_ret_nc(); };
-    instruction_cycles[0xd0] = 8;
-    opcode_table[0xc8] = [this]() { op_ret_z(); };
-    instruction_cycles[0xc8] = 8;
-    opcode_table[0xd8] = [this]() { op_ret_c(); };
-    instruction_cycles[0xd8] = 8;
+    tables.opcode_table[0x09] = [](CPU& cpu) { cpu.add_hl_reg16(cpu.regs.bc.get()); };
+    tables.instruction_cycles[0x09] = 8;
+    tables.opcode_table[0x19] = [](CPU& cpu) { cpu.add_hl_reg16(cpu.regs.de.get()); };
+    tables.instruction_cycles[0x19] = 8;
+    tables.opcode_table[0x29] = [](CPU& cpu) { cpu.add_hl_reg16(cpu.regs.hl.get()); };
+    tables.instruction_cycles[0x29] = 8;
+    tables.opcode_table[0x39] = [](CPU& cpu) { cpu.add_hl_reg16(cpu.regs.sp); };
+    tables.instruction_cycles[0x39] = 8;
+
+    tables.opcode_table[0xc3] = [](CPU& cpu) { cpu.op_jp_a16(); };
+    tables.instruction_cycles[0xc3] = 16;
+    tables.opcode_table[0xe9] = [](CPU& cpu) { cpu.op_jp__hl_(); };
+    tables.instruction_cycles[0xe9] = 4;
+    tables.opcode_table[0xc2] = [](CPU& cpu) { cpu.op_jp_nz_a16(); };
+    tables.instruction_cycles[0xc2] = 12;
+    tables.opcode_table[0xd2] = [](CPU& cpu) { cpu.op_jp_nc_a16(); };
+    tables.instruction_cycles[0xd2] = 12;
+    tables.opcode_table[0xca] = [](CPU& cpu) { cpu.op_jp_z_a16(); };
+    tables.instruction_cycles[0xca] = 12;
+    tables.opcode_table[0xda] = [](CPU& cpu) { cpu.op_jp_c_a16(); };
+    tables.instruction_cycles[0xda] = 12;
+
+    tables.opcode_table[0x18] = [](CPU& cpu) { cpu.op_jr_r8(); };
+    tables.instruction_cycles[0x18] = 12;
+    tables.opcode_table[0x20] = [](CPU& cpu) { cpu.op_jr_nz_r8(); };
+    tables.instruction_cycles[0x20] = 12;
+    tables.opcode_table[0x30] = [](CPU& cpu) { cpu.op_jr_nc_r8(); };
+    tables.instruction_cycles[0x30] = 12;
+    tables.opcode_table[0x28] = [](CPU& cpu) { cpu.op_jr_z_r8(); };
+    tables.instruction_cycles[0x28] = 12;
+    tables.opcode_table[0x38] = [](CPU& cpu) { cpu.op_jr_c_r8(); };
+    tables.instruction_cycles[0x38] = 12;
+
+    tables.opcode_table[0xcd] = [](CPU& cpu) { cpu.op_call_a16(); };
+    tables.instruction_cycles[0xcd] = 24;
+    tables.opcode_table[0xc4] = [](CPU& cpu) { cpu.op_call_nz_a16(); };
+    tables.instruction_cycles[0xc4] = 12;
+    tables.opcode_table[0xd4] = [](CPU& cpu) { cpu.op_call_nc_a16(); };
+    tables.instruction_cycles[0xd4] = 12;
+    tables.opcode_table[0xcc] = [](CPU& cpu) { cpu.op_call_z_a16(); };
+    tables.instruction_cycles[0xcc] = 12;
+    tables.opcode_table[0xdc] = [](CPU& cpu) { cpu.op_call_c_a16(); };
+    tables.instruction_cycles[0xdc] = 12;
+
+    tables.opcode_table[0xc9] = [](CPU& cpu) { cpu.op_ret(); };
+    tables.instruction_cycles[0xc9] = 16;
+    tables.opcode_table[0xd9] = [](CPU& cpu) { cpu.op_reti(); };
+    tables.instruction_cycles[0xd9] = 16;
+    tables.opcode_table[0xc0] = [](CPU& cpu) { cpu.op_ret_nz(); };
+    tables.instruction_cycles[0xc0] = 8;
+    tables.opcode_table[0xd0] = [](CPU& cpu) { cpu.op_ret_nc(); };
+    tables.instruction_cycles[0xd0] = 8;
+    tables.opcode_table[0xc8] = [](CPU& cpu) { cpu.op_ret_z(); };
+    tables.instruction_cycles[0xc8] = 8;
+    tables.opcode_table[0xd8] = [](CPU& cpu) { cpu.op_ret_c(); };
+    tables.instruction_cycles[0xd8] = 8;
 
     for (uint8_t i = 0x0; i < 0x8; ++i) {
         uint8_t opcode = 0xc7 + i * 0x08;
-        opcode_table[opcode] = [this, i]() {
-            call_to(((i / 2) << 3) | (i % 2) * 0x8);
+        tables.opcode_table[opcode] = [i](CPU& cpu) {
+            cpu.call_to(i * 0x08);
         };
-        instruction_cycles[opcode] = 16;
+        tables.instruction_cycles[opcode] = 16;
     }
 
-    opcode_table[0x01] = [this]() { op_ld_bc_d16(); };
-    instruction_cycles[0x01] = 12;
-    opcode_table[0x11] = [this]() { op_ld_de_d16(); };
-    instruction_cycles[0x11] = 12;
-    opcode_table[0x3d] = [this]() { dec_reg(regs.a()); };
-    instruction_cycles[0x3d] = 4;
-    opcode_table[0x21] = [this]() { op_ld_hl_d16(); };
-    instruction_cycles[0x21] = 12;
-    opcode_table[0x31] = [this]() { op_ld_sp_d16(); };
-    instruction_cycles[0x31] = 12;
-    opcode_table[0x08] = [this]() { op_ld__a16__sp(); };
-    instruction_cycles[0x08] = 20;
-    opcode_table[0xf8] = [this]() { op_ld_hl_sp_r8(); };
-    instruction_cycles[0xf8] = 12;
-    opcode_table[0xf9] = [this]() { op_ld_sp_hl(); };
-    instruction_cycles[0xf9] = 8;
+    tables.opcode_table[0x01] = [](CPU& cpu) { cpu.op_ld_bc_d16(); };
+    tables.instruction_cycles[0x01] = 12;
+    tables.opcode_table[0x11] = [](CPU& cpu) { cpu.op_ld_de_d16(); };
+    tables.instruction_cycles[0x11] = 12;
+    tables.opcode_table[0x3d] = [](CPU& cpu) { cpu.dec_reg(cpu.regs.a()); };
+    tables.instruction_cycles[0x3d] = 4;
+    tables.opcode_table[0x21] = [](CPU& cpu) { cpu.op_ld_hl_d16(); };
+    tables.instruction_cycles[0x21] = 12;
+    tables.opcode_table[0x31] = [](CPU& cpu) { cpu.op_ld_sp_d16(); };
+    tables.instruction_cycles[0x31] = 12;
+    tables.opcode_table[0x08] = [](CPU& cpu) { cpu.op_ld__a16__sp(); };
+    tables.instruction_cycles[0x08] = 20;
+    tables.opcode_table[0xf8] = [](CPU& cpu) { cpu.op_ld_hl_sp_r8(); };
+    tables.instruction_cycles[0xf8] = 12;
+    tables.opcode_table[0xf9] = [](CPU& cpu) { cpu.op_ld_sp_hl(); };
+    tables.instruction_cycles[0xf9] = 8;
 
     for (uint8_t i = 0x0; i < 0x8; ++i) {
         uint8_t opcode = 0x06 + i * 0x08;
-        instruction_cycles[opcode] = 8;
-        if (opcode == 0x35) {
-            opcode_table[opcode] = [this]() { op_ld__hl__d8(); };
-            instruction_cycles[opcode] += 4;
+        tables.instruction_cycles[opcode] = 8;
+        if (opcode == 0x36) {
+            tables.opcode_table[opcode] = [](CPU& cpu) { cpu.op_ld__hl__d8(); };
+            tables.instruction_cycles[opcode] += 4;
         } else {
-            opcode_table[opcode] = [this, reg8_getters, i]() {
-                ld_reg8_d8(reg8_getters[i]());
+            tables.opcode_table[opcode] = [i](CPU& cpu) {
+                cpu.ld_reg8_d8(reg8_getters[i](cpu));
             };
         };
     }
@@ -328,199 +333,214 @@ void CPU::setup_tables()
             uint8_t dst_copy = dst;
             uint8_t src_copy = src;
             if (0x70 <= opcode and opcode < 0x78) {
-                opcode_table[opcode] = [this, reg8_getters, src_copy]() {
-                    ld__hl__r8(reg8_getters[src_copy]());
+                tables.opcode_table[opcode] = [src_copy](CPU& cpu) {
+                    cpu.ld__hl__r8(reg8_getters[src_copy](cpu));
+                };
+                tables.instruction_cycles[opcode] = 8;
+            } else if (src == 0x6) {
+                tables.opcode_table[opcode] = [dst_copy](CPU& cpu) {
+                    cpu.ld_r8_r8(reg8_getters[dst_copy](cpu), cpu.memory.read8(cpu.regs.hl.get()));
                 };
-                instruction_cycles[opcode] = 8;
+                tables.instruction_cycles[opcode] = 8;
             } else {
-                opcode_table[opcode] = [this, reg8_getters, dst_copy, src_copy]() {
-                    ld_r8_r8(reg8_getters[dst_copy](), reg8_getters[src_copy]());
+                tables.opcode_table[opcode] = [dst_copy, src_copy](CPU& cpu) {
+                    cpu.ld_r8_r8(reg8_getters[dst_copy](cpu), reg8_getters[src_copy](cpu));
                 };
-                instruction_cycles[opcode] = src == 0x6 ? 8 : 4;
+                tables.instruction_cycles[opcode] = 4;
             }
         }
     }
 
-    opcode_table[0x02] = [this]() { op_ld__bc__a(); };
-    instruction_cycles[0x02] = 8;
-    opcode_table[0x12] = [this]() { op_ld__de__a(); };
-    instruction_cycles[0x12] = 8;
-    opcode_table[0x22] = [this]() { op_ld__hlp__a(); };
-    instruction_cycles[0x22] = 8;
-    opcode_table[0x32] = [this]() { op_ld__hlm__a(); };
-    instruction_cycles[0x32] = 8;
-
-    opcode_table[0x0a] = [this]() { op_ld_a__bc_(); };
-    instruction_cycles[0x0a] = 8;
-    opcode_table[0x1a] = [this]() { op_ld_a__de_(); };
-    instruction_cycles[0x1a] = 8;
-    opcode_table[0x2a] = [this]() { op_ld_a__hlp_(); };
-    instruction_cycles[0x2a] = 8;
-    opcode_table[0x3a] = [this]() { op_ld_a__hlm_(); };
-    instruction_cycles[0x3a] = 8;
-
-    opcode_table[0xea] = [this]() { op_ld__a16__a(); };
-    instruction_cycles[0xea] = 16;
-    opcode_table[0xfa] = [this]() { op_ld_a__a16_(); };
-    instruction_cycles[0xfa] = 16;
-    opcode_table[0xe0] = [this]() { op_ldh__a8__a(); };
-    instruction_cycles[0xe0] = 12;
-    opcode_table[0xf0] = [this]() { op_ldh_a__a8_(); };
-    instruction_cycles[0xf0] = 12;
-    opcode_table[0xe2] = [this]() { op_ld__c__a(); };
-    instruction_cycles[0xe2] = 8;
-    opcode_table[0xf2] = [this]() { op_ld_a__c_(); };
-    instruction_cycles[0xf2] = 8;
-
-    opcode_table[0xc5] = [this]() { push_reg(regs.bc); };
-    instruction_cycles[0xc5] = 16;
-    opcode_table[0xd5] = [this]() { push_reg(regs.de); };
-    instruction_cycles[0xd5] = 16;
-    opcode_table[0xe5] = [this]() { push_reg(regs.hl); };
-    instruction_cycles[0xe5] = 16;
-    opcode_table[0xf5] = [this]() { push_reg(regs.af); };
-    instruction_cycles[0xf5] = 16;
-
-    opcode_table[0xc1] = [this]() { pop_reg(regs.bc); };
-    instruction_cycles[0xc1] = 12;
-    opcode_table[0xd1] = [this]() { pop_reg(regs.de); };
-    instruction_cycles[0xd1] = 12;
-    opcode_table[0xe1] = [this]() { pop_reg(regs.hl); };
-    instruction_cycles[0xe1] = 12;
-    opcode_table[0xf1] = [this]() { pop_reg(regs.af, true); };
-    instruction_cycles[0xf1] = 12;
-
-    register_reg8_manip_group(0x80, reg8_getters, [this](uint8_t& r) { add_reg_update_flags(r); });
-    register_reg8_manip_group(0x88, reg8_getters, [this](uint8_t& r) { add_reg_update_flags(r, true); });
-    opcode_table[0xc6] = [this]() { op_add_d8(); };
-    instruction_cycles[0xc6] = 8;
-    opcode_table[0xce] = [this]() { op_adc_d8(); };
-    instruction_cycles[0xce] = 8;
-
-    register_reg8_manip_group(0x90, reg8_getters, [this](uint8_t& r) { sub_reg_update_flags(r); });
-    register_reg8_manip_group(0x98, reg8_getters, [this](uint8_t& r) { sub_reg_update_flags(r, true); });
-    opcode_table[0xd6] = [this]() { op_sub_d8(); };
-    instruction_cycles[0xd6] = 8;
-    opcode_table[0xde] = [this]() { op_sbc_d8(); };
-    instruction_cycles[0xde] = 8;
-
-    register_reg8_manip_group(0xa0, reg8_getters, [this](uint8_t& r) { and_reg_update_flags(r); });
-    opcode_table[0xe6] = [this]() { op_and_d8(); };
-    instruction_cycles[0xe6] = 8;
-
-    register_reg8_manip_group(0xa8, reg8_getters, [this](uint8_t& r) { xor_reg_update_flags(r); });
-    opcode_table[0xee] = [this]() { op_xor_d8(); };
-    instruction_cycles[0xee] = 8;
-
-    register_reg8_manip_group(0xb0, reg8_getters, [this](uint8_t& r) { or_reg_update_flags(r); });
-    opcode_table[0xf6] = [this]() { op_or_d8(); };
-    instruction_cycles[0xf6] = 8;
-
-    register_reg8_manip_group(0xb8, reg8_getters, [this](uint8_t& r) { cp_reg_update_flags(r); });
-    opcode_table[0xfe] = [this]() { op_cp_d8(); };
-    instruction_cycles[0xfe] = 8;
-
-    opcode_table[0x07] = [this]() { op_rlca(); };
-    instruction_cycles[0x07] = 4;
-    opcode_table[0x17] = [this]() { op_rla(); };
-    instruction_cycles[0x17] = 4;
-    opcode_table[0x0f] = [this]() { op_rrca(); };
-    instruction_cycles[0x0f] = 4;
-    opcode_table[0x1f] = [this]() { op_rra(); };
-    instruction_cycles[0x1f] = 4;
-
-    opcode_table[0x3f] = [this]() { op_ccf(); };
-    instruction_cycles[0x3f] = 4;
-    opcode_table[0x37] = [this]() { op_scf(); };
-    instruction_cycles[0x37] = 4;
-    opcode_table[0x27] = [this]() { op_daa(); };
-    instruction_cycles[0x27] = 4;
-    opcode_table[0x2f] = [this]() { op_cpl(); };
-    instruction_cycles[0x2f] = 4;
-
-    opcode_table[0xe8] = [this]() { op_add_sp_r8(); };
-    instruction_cycles[0xe8] = 16;
-
-    register_cb_group(0x00, reg8_getters, [this](uint8_t& r) { op_rlc_reg8(r); }, [this]() { op_rlc__hl_(); });
-    register_cb_group(0x08, reg8_getters, [this](uint8_t& r) { op_rrc_reg8(r); }, [this]() { op_rrc__hl_(); });
-    register_cb_group(0x10, reg8_getters, [this](uint8_t& r) { op_rl_reg8(r); }, [this]() { op_rl__hl_(); });
-    register_cb_group(0x18, reg8_getters, [this](uint8_t& r) { op_rr_reg8(r); }, [this]() { op_rr__hl_(); });
-    register_cb_group(0x20, reg8_getters, [this](uint8_t& r) { op_sla_reg8(r); }, [this]() { op_sla__hl_(); });
-    register_cb_group(0x28, reg8_getters, [this](uint8_t& r) { op_sra_reg8(r); }, [this]() { op_sra__hl_(); });
-    register_cb_group(0x30, reg8_getters, [this](uint8_t& r) { op_swap_reg8(r); }, [this]() { op_swap__hl_(); });
-    register_cb_group(0x38, reg8_getters, [this](uint8_t& r) { op_srl_reg8(r); }, [this]() { op_srl__hl_(); });
-
-    register_cb_group_large(
+    tables.opcode_table[0x02] = [](CPU& cpu) { cpu.op_ld__bc__a(); };
+    tables.instruction_cycles[0x02] = 8;
+    tables.opcode_table[0x12] = [](CPU& cpu) { cpu.op_ld__de__a(); };
+    tables.instruction_cycles[0x12] = 8;
+    tables.opcode_table[0x22] = [](CPU& cpu) { cpu.op_ld__hlp__a(); };
+    tables.instruction_cycles[0x22] = 8;
+    tables.opcode_table[0x32] = [](CPU& cpu) { cpu.op_ld__hlm__a(); };
+    tables.instruction_cycles[0x32] = 8;
+
+    tables.opcode_table[0x0a] = [](CPU& cpu) { cpu.op_ld_a__bc_(); };
+    tables.instruction_cycles[0x0a] = 8;
+    tables.opcode_table[0x1a] = [](CPU& cpu) { cpu.op_ld_a__de_(); };
+    tables.instruction_cycles[0x1a] = 8;
+    tables.opcode_table[0x2a] = [](CPU& cpu) { cpu.op_ld_a__hlp_(); };
+    tables.instruction_cycles[0x2a] = 8;
+    tables.opcode_table[0x3a] = [](CPU& cpu) { cpu.op_ld_a__hlm_(); };
+    tables.instruction_cycles[0x3a] = 8;
+
+    tables.opcode_table[0xea] = [](CPU& cpu) { cpu.op_ld__a16__a(); };
+    tables.instruction_cycles[0xea] = 16;
+    tables.opcode_table[0xfa] = [](CPU& cpu) { cpu.op_ld_a__a16_(); };
+    tables.instruction_cycles[0xfa] = 16;
+    tables.opcode_table[0xe0] = [](CPU& cpu) { cpu.op_ldh__a8__a(); };
+    tables.instruction_cycles[0xe0] = 12;
+    tables.opcode_table[0xf0] = [](CPU& cpu) { cpu.op_ldh_a__a8_(); };
+    tables.instruction_cycles[0xf0] = 12;
+    tables.opcode_table[0xe2] = [](CPU& cpu) { cpu.op_ld__c__a(); };
+    tables.instruction_cycles[0xe2] = 8;
+    tables.opcode_table[0xf2] = [](CPU& cpu) { cpu.op_ld_a__c_(); };
+    tables.instruction_cycles[0xf2] = 8;
+
+    tables.opcode_table[0xc5] = [](CPU& cpu) { cpu.push_reg(cpu.regs.bc); };
+    tables.instruction_cycles[0xc5] = 16;
+    tables.opcode_table[0xd5] = [](CPU& cpu) { cpu.push_reg(cpu.regs.de); };
+    tables.instruction_cycles[0xd5] = 16;
+    tables.opcode_table[0xe5] = [](CPU& cpu) { cpu.push_reg(cpu.regs.hl); };
+    tables.instruction_cycles[0xe5] = 16;
+    tables.opcode_table[0xf5] = [](CPU& cpu) { cpu.push_reg(cpu.regs.af); };
+    tables.instruction_cycles[0xf5] = 16;
+
+    tables.opcode_table[0xc1] = [](CPU& cpu) { cpu.pop_reg(cpu.regs.bc); };
+    tables.instruction_cycles[0xc1] = 12;
+    tables.opcode_table[0xd1] = [](CPU& cpu) { cpu.pop_reg(cpu.regs.de); };
+    tables.instruction_cycles[0xd1] = 12;
+    tables.opcode_table[0xe1] = [](CPU& cpu) { cpu.pop_reg(cpu.regs.hl); };
+    tables.instruction_cycles[0xe1] = 12;
+    tables.opcode_table[0xf1] = [](CPU& cpu) { cpu.pop_reg(cpu.regs.af, true); };
+    tables.instruction_cycles[0xf1] = 12;
+
+    register_reg8_manip_group(tables, 0x80, [](CPU& cpu, uint8_t r) { cpu.add_reg_update_flags(r); });
+    register_reg8_manip_group(tables, 0x88, [](CPU& cpu, uint8_t r) { cpu.add_reg_update_flags(r, true); });
+    tables.opcode_table[0xc6] = [](CPU& cpu) { cpu.op_add_d8(); };
+    tables.instruction_cycles[0xc6] = 8;
+    tables.opcode_table[0xce] = [](CPU& cpu) { cpu.op_adc_d8(); };
+    tables.instruction_cycles[0xce] = 8;
+
+    register_reg8_manip_group(tables, 0x90, [](CPU& cpu, uint8_t r) { cpu.sub_reg_update_flags(r); });
+    register_reg8_manip_group(tables, 0x98, [](CPU& cpu, uint8_t r) { cpu.sub_reg_update_flags(r, true); });
+    tables.opcode_table[0xd6] = [](CPU& cpu) { cpu.op_sub_d8(); };
+    tables.instruction_cycles[0xd6] = 8;
+    tables.opcode_table[0xde] = [](CPU& cpu) { cpu.op_sbc_d8(); };
+    tables.instruction_cycles[0xde] = 8;
+
+    register_reg8_manip_group(tables, 0xa0, [](CPU& cpu, uint8_t r) { cpu.and_reg_update_flags(r); });
+    tables.opcode_table[0xe6] = [](CPU& cpu) { cpu.op_and_d8(); };
+    tables.instruction_cycles[0xe6] = 8;
+
+    register_reg8_manip_group(tables, 0xa8, [](CPU& cpu, uint8_t r) { cpu.xor_reg_update_flags(r); });
+    tables.opcode_table[0xee] = [](CPU& cpu) { cpu.op_xor_d8(); };
+    tables.instruction_cycles[0xee] = 8;
+
+    register_reg8_manip_group(tables, 0xb0, [](CPU& cpu, uint8_t r) { cpu.or_reg_update_flags(r); });
+    tables.opcode_table[0xf6] = [](CPU& cpu) { cpu.op_or_d8(); };
+    tables.instruction_cycles[0xf6] = 8;
+
+    register_reg8_manip_group(tables, 0xb8, [](CPU& cpu, uint8_t r) { cpu.cp_reg_update_flags(r); });
+    tables.opcode_table[0xfe] = [](CPU& cpu) { cpu.op_cp_d8(); };
+    tables.instruction_cycles[0xfe] = 8;
+
+    tables.opcode_table[0x07] = [](CPU& cpu) { cpu.op_rlca(); };
+    tables.instruction_cycles[0x07] = 4;
+    tables.opcode_table[0x17] = [](CPU& cpu) { cpu.op_rla(); };
+    tables.instruction_cycles[0x17] = 4;
+    tables.opcode_table[0x0f] = [](CPU& cpu) { cpu.op_rrca(); };
+    tables.instruction_cycles[0x0f] = 4;
+    tables.opcode_table[0x1f] = [](CPU& cpu) { cpu.op_rra(); };
+    tables.instruction_cycles[0x1f] = 4;
+
+    tables.opcode_table[0x3f] = [](CPU& cpu) { cpu.op_ccf(); };
+    tables.instruction_cycles[0x3f] = 4;
+    tables.opcode_table[0x37] = [](CPU& cpu) { cpu.op_scf(); };
+    tables.instruction_cycles[0x37] = 4;
+    tables.opcode_table[0x27] = [](CPU& cpu) { cpu.op_daa(); };
+    tables.instruction_cycles[0x27] = 4;
+    tables.opcode_table[0x2f] = [](CPU& cpu) { cpu.op_cpl(); };
+    tables.instruction_cycles[0x2f] = 4;
+
+    tables.opcode_table[0xe8] = [](CPU& cpu) { cpu.op_add_sp_r8(); };
+    tables.instruction_cycles[0xe8] = 16;
+
+    register_cb_group(
+        tables, 0x00, [](CPU& cpu, uint8_t& r) { cpu.op_rlc_reg8(r); }, [](CPU& cpu) { cpu.op_rlc__hl_(); });
+    register_cb_group(
+        tables, 0x08, [](CPU& cpu, uint8_t& r) { cpu.op_rrc_reg8(r); }, [](CPU& cpu) { cpu.op_rrc__hl_(); });
+    register_cb_group(
+        tables, 0x10, [](CPU& cpu, uint8_t& r) { cpu.op_rl_reg8(r); }, [](CPU& cpu) { cpu.op_rl__hl_(); });
+    register_cb_group(
+        tables, 0x18, [](CPU& cpu, uint8_t& r) { cpu.op_rr_reg8(r); }, [](CPU& cpu) { cpu.op_rr__hl_(); });
+    register_cb_group(
+        tables, 0x20, [](CPU& cpu, uint8_t& r) { cpu.op_sla_reg8(r); }, [](CPU& cpu) { cpu.op_sla__hl_(); });
+    register_cb_group(
+        tables, 0x28, [](CPU& cpu, uint8_t& r) { cpu.op_sra_reg8(r); }, [](CPU& cpu) { cpu.op_sra__hl_(); });
+    register_cb_group(
+        tables, 0x30, [](CPU& cpu, uint8_t& r) { cpu.op_swap_reg8(r); }, [](CPU& cpu) { cpu.op_swap__hl_(); });
+    register_cb_group(
+        tables, 0x38, [](CPU& cpu, uint8_t& r) { cpu.op_srl_reg8(r); }, [](CPU& cpu) { cpu.op_srl__hl_(); });
+
+    register_cb_group_large(tables,
         0x40,
-        reg8_getters,
-        [this](const uint8_t r, const uint8_t bit) { bit_b_reg8(r, bit); },
-        [this](const uint8_t bit) { op_bit_b__hl_(bit); });
-    register_cb_group_large(
+        [](CPU& cpu, const uint8_t r, const uint8_t bit) { cpu.bit_b_reg8(r, bit); },
+        [](CPU& cpu, const uint8_t bit) { cpu.op_bit_b__hl_(bit); });
+    register_cb_group_large(tables,
         0x80,
-        reg8_getters,
-        [this](uint8_t& r, const uint8_t bit) { res_b_reg8(r, bit); },
-        [this](const uint8_t bit) { op_res_b__hl_(bit); });
-    register_cb_group_large(
+        [](CPU& cpu, uint8_t& r, const uint8_t bit) { cpu.res_b_reg8(r, bit); },
+        [](CPU& cpu, const uint8_t bit) { cpu.op_res_b__hl_(bit); });
+    register_cb_group_large(tables,
         0xc0,
-        reg8_getters,
-        [this](uint8_t& r, const uint8_t bit) { set_b_reg8(r, bit); },
-        [this](const uint8_t bit) { op_set_b__hl_(bit); });
+        [](CPU& cpu, uint8_t& r, const uint8_t bit) { cpu.set_b_reg8(r, bit); },
+        [](CPU& cpu, const uint8_t bit) { cpu.op_set_b__hl_(bit); });
+
+    return tables;
 }
 
-void CPU::register_reg8_manip_group(uint8_t start_code,
-    const std::array<std::function<uint8_t&()>, 8>& reg8_getters,
-    std::function<void(uint8_t&)> fn)
+void CPU::register_reg8_manip_group(InstructionTables& tables,
+    uint8_t start_code,
+    std::function<void(CPU&, uint8_t)> fn)
 {
     for (uint8_t i = 0x0; i < 0x8; ++i) {
         uint8_t opcode = start_code + i;
-        instruction_cycles[opcode] = 4;
-        opcode_table[opcode] = [this, reg8_getters, fn, i]() {
-            fn(reg8_getters[i]());
-        };
-        if (i == 6)
-            instruction_cycles[opcode] += 4;
+        tables.instruction_cycles[opcode] = 4;
+        if (i == 6) {
+            tables.opcode_table[opcode] = [fn](CPU& cpu) {
+                fn(cpu, cpu.memory.read8(cpu.regs.hl.get()));
+            };
+            tables.instruction_cycles[opcode] += 4;
+        } else {
+            tables.opcode_table[opcode] = [fn, i](CPU& cpu) {
+                fn(cpu, reg8_getters[i](cpu));
+            };
+        }
     }
 }
 
-void CPU::register_cb_group(uint8_t start_code,
-    const std::array<std::function<uint8_t&()>, 8>& reg8_getters,
-    std::function<void(uint8_t&)> reg8_fn,
-    std::function<void()> hl_fn)
+void CPU::register_cb_group(InstructionTables& tables,
+    uint8_t start_code,
+    std::function<void(CPU&, uint8_t&)> reg8_fn,
+    std::function<void(CPU&)> hl_fn)
 {
     for (uint8_t i = 0; i < 0x8; ++i) {
         uint8_t opcode = start_code + i;
-        cb_instruction_cycles[opcode] = 8;
+        tables.cb_instruction_cycles[opcode] = 8;
         if (i == 6) {
-            cbcode_table[opcode] = [this, hl_fn]() {
-                hl_fn();
-            };
-            cb_instruction_cycles[opcode] += 8;
+            tables.cbcode_table[opcode] = hl_fn;
+            tables.cb_instruction_cycles[opcode] += 8;
         } else {
-            cbcode_table[opcode] = [this, reg8_fn, reg8_getters, i]() {
-                reg8_fn(reg8_getters[i]());
+            tables.cbcode_table[opcode] = [reg8_fn, i](CPU& cpu) {
+                reg8_fn(cpu, reg8_getters[i](cpu));
             };
         }
     }
 }
 
 template <typename Reg8Fn>
-void CPU::register_cb_group_large(uint8_t start_code,
-    const std::array<std::function<uint8_t&()>, 8>& reg8_getters,
+void CPU::register_cb_group_large(InstructionTables& tables,
+    uint8_t start_code,
     Reg8Fn reg8_fn,
-    std::function<void(const uint8_t)> hl_fn)
+    std::function<void(CPU&, const uint8_t)> hl_fn)
 {
     for (uint8_t bit = 0; bit < 0x8; ++bit) {
         for (uint8_t i = 0; i < 0x8; ++i) {
             uint8_t opcode = start_code + i + bit * 0x8;
-            cb_instruction_cycles[opcode] = 8;
+            tables.cb_instruction_cycles[opcode] = 8;
             if (i == 6) {
-                cbcode_table[opcode] = [this, hl_fn, bit]() {
-                    hl_fn(bit);
+                tables.cbcode_table[opcode] = [hl_fn, bit](CPU& cpu) {
+                    hl_fn(cpu, bit);
                 };
-                cb_instruction_cycles[opcode] += 8;
+                tables.cb_instruction_cycles[opcode] += 8;
             } else {
-                cbcode_table[opcode] = [this, reg8_fn, reg8_getters, i, bit]() {
-                    reg8_fn(reg8_getters[i](), bit);
+                tables.cbcode_table[opcode] = [reg8_fn, i, bit](CPU& cpu) {
+                    reg8_fn(cpu, reg8_getters[i](cpu), bit);
                 };
             }
         }
@@ -529,20 +549,24 @@ void CPU::register_cb_group_large(uint8_t start_code,
 
 uint8_t CPU::fetch_byte()
 {
-    return memory.read_byte(regs.pc++);
+    return memory.read8(regs.pc++);
 }
 
 uint16_t CPU::fetch_word()
 {
-    return build_word(fetch_byte(), fetch_byte());
+    uint16_t word = memory.read16(regs.pc);
+    regs.pc += 2;
+    return word;
 }
 
 void CPU::decode_and_execute()
 {
-    if (opcode_table.contains(opcode))
-        opcode_table[opcode]();
-    else
-        throw std::runtime_error(std::format("Unknown opcode: 0x{:X}", opcode));
+    if (!tables.opcode_table[opcode]) [[unlikely]] {
+        char hex[3] {};
+        std::to_chars(hex, hex + 2, opcode, 16);
+        throw std::runtime_error(std::string("Unknown opcode: 0x") + hex);
+    }
+    tables.opcode_table[opcode](*this);
 }
 
 void CPU::op_nop() { }
@@ -596,7 +620,7 @@ inline uint8_t CPU::inc_reg8_update_flags(uint8_t reg_val)
 
 void CPU::op_inc__hl_()
 {
-    memory.write_byte(regs.hl.get(), inc_reg8_update_flags(memory.read_byte(regs.hl.get())));
+    memory.write8(regs.hl.get(), inc_reg8_update_flags(memory.read8(regs.hl.get())));
 }
 
 inline void CPU::dec_reg(RegisterPair& reg)
@@ -626,7 +650,7 @@ inline uint8_t CPU::dec_reg8_update_flags(uint8_t reg_val)
 
 void CPU::op_dec__hl_()
 {
-    memory.write_byte(regs.hl.get(), dec_reg8_update_flags(memory.read_byte(regs.hl.get())));
+    memory.write8(regs.hl.get(), dec_reg8_update_flags(memory.read8(regs.hl.get())));
 }
 
 inline void CPU::add_hl_reg16(uint16_t value)
@@ -724,8 +748,8 @@ void CPU::op_jr_c_r8()
 inline void CPU::call_to(uint16_t addr)
 {
     uint16_t ret = regs.pc;
-    memory.write_byte(--regs.sp, msb(ret));
-    memory.write_byte(--regs.sp, lsb(ret));
+    memory.write8(--regs.sp, msb(ret));
+    memory.write8(--regs.sp, lsb(ret));
     regs.pc = addr;
 }
 
@@ -764,9 +788,8 @@ void CPU::op_call_c_a16()
 
 void CPU::op_ret()
 {
-    uint8_t lsb = memory.read_byte(regs.sp++);
-    uint8_t msb = memory.read_byte(regs.sp++);
-    regs.pc = build_word(lsb, msb);
+    regs.pc = memory.read16(regs.sp);
+    regs.sp += 2;
 }
 
 void CPU::op_reti()
@@ -825,9 +848,7 @@ void CPU::op_ld_sp_d16()
 
 void CPU::op_ld__a16__sp()
 {
-    uint16_t addr = fetch_word();
-    memory.write_byte(addr, lsb(regs.sp));
-    memory.write_byte(addr + 1, msb(regs.sp));
+    memory.write16(fetch_word(), regs.sp);
 }
 
 void CPU::op_ld_hl_sp_r8()
@@ -852,7 +873,7 @@ inline void CPU::ld_reg8_d8(uint8_t& reg)
 
 void CPU::op_ld__hl__d8()
 {
-    memory.write_byte(regs.hl.get(), fetch_byte());
+    memory.write8(regs.hl.get(), fetch_byte());
 }
 
 inline void CPU::ld_r8_r8(uint8_t& dst, const uint8_t value)
@@ -862,94 +883,93 @@ inline void CPU::ld_r8_r8(uint8_t& dst, const uint8_t value)
 
 inline void CPU::ld__hl__r8(const uint8_t value)
 {
-    memory.write_byte(regs.hl.get(), value);
+    memory.write8(regs.hl.get(), value);
 }
 
 void CPU::op_ld__bc__a()
 {
-    memory.write_byte(regs.bc.get(), regs.a());
+    memory.write8(regs.bc.get(), regs.a());
 }
 
 void CPU::op_ld__de__a()
 {
-    memory.write_byte(regs.de.get(), regs.a());
+    memory.write8(regs.de.get(), regs.a());
 }
 
 void CPU::op_ld__hlp__a()
 {
-    memory.write_byte(regs.hl.get()++, regs.a());
+    memory.write8(regs.hl.get()++, regs.a());
 }
 
 void CPU::op_ld__hlm__a()
 {
-    memory.write_byte(regs.hl.get()--, regs.a());
+    memory.write8(regs.hl.get()--, regs.a());
 }
 
 void CPU::op_ld_a__bc_()
 {
-    regs.a() = memory.read_byte(regs.bc.get());
+    regs.a() = memory.read8(regs.bc.get());
 }
 
 void CPU::op_ld_a__de_()
 {
-    regs.a() = memory.read_byte(regs.de.get());
+    regs.a() = memory.read8(regs.de.get());
 }
 
 void CPU::op_ld_a__hlp_()
 {
-    regs.a() = memory.read_byte(regs.hl.get()++);
+    regs.a() = memory.read8(regs.hl.get()++);
 }
 
 void CPU::op_ld_a__hlm_()
 {
-    regs.a() = memory.read_byte(regs.hl.get()--);
+    regs.a() = memory.read8(regs.hl.get()--);
 }
 
 void CPU::op_ld__a16__a()
 {
-    memory.write_byte(fetch_word(), regs.a());
+    memory.write8(fetch_word(), regs.a());
 }
 
 void CPU::op_ld_a__a16_()
 {
-    regs.a() = memory.read_byte(fetch_word());
+    regs.a() = memory.read8(fetch_word());
 }
 
 void CPU::op_ldh__a8__a()
 {
-    memory.write_byte(build_word(fetch_byte(), 0xff), regs.a());
+    memory.write8(build_word(fetch_byte(), 0xff), regs.a());
 }
 
 void CPU::op_ldh_a__a8_()
 {
-    regs.a() = memory.read_byte(build_word(fetch_byte(), 0xff));
+    regs.a() = memory.read8(build_word(fetch_byte(), 0xff));
 }
 
 void CPU::op_ld__c__a()
 {
-    memory.write_byte(build_word(regs.c(), 0xff), regs.a());
+    memory.write8(build_word(regs.c(), 0xff), regs.a());
 }
 
 void CPU::op_ld_a__c_()
 {
-    regs.a() = memory.read_byte(build_word(regs.c(), 0xff));
+    regs.a() = memory.read8(build_word(regs.c(), 0xff));
 }
 
 inline void CPU::push_reg(RegisterPair& reg)
 {
 
-    memory.write_byte(--regs.sp, msb(reg.get()));
-    memory.write_byte(--regs.sp, lsb(reg.get()));
+    memory.write8(--regs.sp, msb(reg.get()));
+    memory.write8(--regs.sp, lsb(reg.get()));
 }
 
 inline void CPU::pop_reg(RegisterPair& reg, bool clear_lower_4bits)
 {
-
-    uint8_t lsb = memory.read_byte(regs.sp++);
+    uint16_t word = memory.read16(regs.sp);
+    regs.sp += 2;
     if (clear_lower_4bits)
-        lsb &= 0xF0;
-    uint8_t msb = memory.read_byte(regs.sp++);
-    reg.set(build_word(lsb, msb));
+        word &= 0xFFF0;
+    reg.set(word);
 }
 
 inline void CPU::add_reg_update_flags(uint8_t reg_val, bool use_carry)
@@ -1170,10 +1190,10 @@ inline void CPU::op_rlc_reg8(uint8_t& reg)
 
 void CPU::op_rlc__hl_()
 {
-    uint8_t data = memory.read_byte(regs.hl.get());
+    uint8_t data = memory.read8(regs.hl.get());
     bool b7 = (data >> 7) & 0x1;
     uint8_t result = (data << 1) | b7;
-    memory.write_byte(regs.hl.get(), result);
+    memory.write8(regs.hl.get(), result);
     update_rotate_flags(result, b7);
 }
 
@@ -1186,10 +1206,10 @@ inline void CPU::op_rrc_reg8(uint8_t& reg)
 
 void CPU::op_rrc__hl_()
 {
-    uint8_t data = memory.read_byte(regs.hl.get());
+    uint8_t data = memory.read8(regs.hl.get());
     bool b0 = data & 0x1;
     uint8_t result = (b0 << 7) | (data >> 1);
-    memory.write_byte(regs.hl.get(), result);
+    memory.write8(regs.hl.get(), result);
     update_rotate_flags(result, b0);
 }
 
@@ -1202,10 +1222,10 @@ inline void CPU::op_rl_reg8(uint8_t& reg)
 
 void CPU::op_rl__hl_()
 {
-    uint8_t data = memory.read_byte(regs.hl.get());
+    uint8_t data = memory.read8(regs.hl.get());
     bool b7 = (data >> 7) & 0x1;
     uint8_t result = (data << 1) | (regs.get_flag(Registers::FLAG_C));
-    memory.write_byte(regs.hl.get(), result);
+    memory.write8(regs.hl.get(), result);
     update_rotate_flags(result, b7);
 }
 
@@ -1218,10 +1238,10 @@ inline void CPU::op_rr_reg8(uint8_t& reg)
 
 void CPU::op_rr__hl_()
 {
-    uint8_t data = memory.read_byte(regs.hl.get());
+    uint8_t data = memory.read8(regs.hl.get());
     bool b0 = data & 0x1;
     uint8_t result = (regs.get_flag(Registers::FLAG_C) << 7) | (data >> 1);
-    memory.write_byte(regs.hl.get(), result);
+    memory.write8(regs.hl.get(), result);
     update_rotate_flags(result, b0);
 }
 
@@ -1234,10 +1254,10 @@ inline void CPU::op_sla_reg8(uint8_t& reg)
 
 void CPU::op_sla__hl_()
 {
-    uint8_t data = memory.read_byte(regs.hl.get());
+    uint8_t data = memory.read8(regs.hl.get());
     bool b7 = (data >> 7) & 0x1;
     uint8_t result = (data << 1);
-    memory.write_byte(regs.hl.get(), result);
+    memory.write8(regs.hl.get(), result);
     update_rotate_flags(result, b7);
 }
 
@@ -1251,11 +1271,11 @@ inline void CPU::op_sra_reg8(uint8_t& reg)
 
 void CPU::op_sra__hl_()
 {
-    uint8_t data = memory.read_byte(regs.hl.get());
+    uint8_t data = memory.read8(regs.hl.get());
     bool b7 = (data >> 7) & 0x1;
     bool b0 = data & 0x1;
     uint8_t result = (data >> 1) | (b7 << 7);
-    memory.write_byte(regs.hl.get(), result);
+    memory.write8(regs.hl.get(), result);
     update_rotate_flags(result, b0);
 }
 
@@ -1267,9 +1287,9 @@ inline void CPU::op_swap_reg8(uint8_t& reg)
 
 void CPU::op_swap__hl_()
 {
-    uint8_t data = memory.read_byte(regs.hl.get());
+    uint8_t data = memory.read8(regs.hl.get());
     uint8_t result = (data >> 4) | ((data << 4) & 0xf0);
-    memory.write_byte(regs.hl.get(), result);
+    memory.write8(regs.hl.get(), result);
     update_rotate_flags(result, false);
 }
 
@@ -1282,10 +1302,10 @@ inline void CPU::op_srl_reg8(uint8_t& reg)
 
 void CPU::op_srl__hl_()
 {
-    uint8_t data = memory.read_byte(regs.hl.get());
+    uint8_t data = memory.read8(regs.hl.get());
     bool b0 = data & 0x1;
     uint8_t result = (data >> 1);
-    memory.write_byte(regs.hl.get(), result);
+    memory.write8(regs.hl.get(), result);
     update_rotate_flags(result, b0);
 }
 
@@ -1298,7 +1318,7 @@ inline void CPU::bit_b_reg8(const uint8_t reg, const uint8_t bit)
 
 void CPU::op_bit_b__hl_(const uint8_t bit)
 {
-    bit_b_reg8(memory.read_byte(regs.hl.get()), bit);
+    bit_b_reg8(memory.read8(regs.hl.get()), bit);
 }
 
 inline void CPU::res_b_reg8(uint8_t& reg, const uint8_t bit)
@@ -1308,7 +1328,7 @@ inline void CPU::res_b_reg8(uint8_t& reg, const uint8_t bit)
 
 void CPU::op_res_b__hl_(const uint8_t bit)
 {
-    memory.at(regs.hl.get()) &= ~(0x1 << bit);
+    memory.write8(regs.hl.get(), memory.read8(regs.hl.get()) & ~(0x1 << bit));
 }
 
 inline void CPU::set_b_reg8(uint8_t& reg, const uint8_t bit)
@@ -1317,5 +1337,5 @@ inline void CPU::set_b_reg8(uint8_t& reg, const uint8_t bit)
 }
 void CPU::op_set_b__hl_(const uint8_t bit)
 {
-    memory.at(regs.hl.get()) |= 0x1 << bit;
+    memory.write8(regs.hl.get(), memory.read8(regs.hl.get()) | (0x1 << bit));
 }
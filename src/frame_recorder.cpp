@@ -0,0 +1,195 @@
+#include "frame_recorder.hpp"
+#include "ppu.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+
+namespace {
+
+constexpr size_t FRAME_PIXELS = PPU::SCREEN_WIDTH * PPU::SCREEN_HEIGHT; /**< Size of a gray frame in the file. */
+constexpr size_t SLOT_BYTES = FRAME_PIXELS * 4; /**< Size of a queued frame, large enough for any format. */
+
+/**
+ * @brief Converts a frame to 8-bit gray.
+ *
+ * @param pixels The frame, rows of PPU::SCREEN_WIDTH pixels back to back.
+ * @param format Format of the pixels.
+ * @param gray Receives the FRAME_PIXELS gray values.
+ */
+void to_gray(const uint8_t* pixels, PixelFormat format, uint8_t* gray)
+{
+    switch (format) {
+    case PixelFormat::Shade2:
+        write_pixels(pixels, FRAME_PIXELS, make_pixel_table(shade_palette_table, PixelFormat::Gray8),
+            PixelFormat::Gray8, gray);
+        break;
+    case PixelFormat::Gray8:
+        std::memcpy(gray, pixels, FRAME_PIXELS);
+        break;
+    case PixelFormat::Rgb565:
+        for (size_t i = 0; i < FRAME_PIXELS; ++i) {
+            uint16_t pixel = pixels[i * 2] | (pixels[i * 2 + 1] << 8);
+            uint32_t r = (pixel >> 11) * 255 / 31, g = ((pixel >> 5) & 0x3f) * 255 / 63, b = (pixel & 0x1f) * 255 / 31;
+            gray[i] = (r * 77 + g * 150 + b * 29) >> 8;
+        }
+        break;
+    case PixelFormat::Rgba8888:
+        for (size_t i = 0; i < FRAME_PIXELS; ++i)
+            gray[i] = (pixels[i * 4] * 77 + pixels[i * 4 + 1] * 150 + pixels[i * 4 + 2] * 29) >> 8;
+        break;
+    }
+}
+
+/**
+ * @brief Creates a file, or truncates it.
+ *
+ * @param path Path of the file.
+ * @return Its file descriptor.
+ * @throws std::runtime_error if the file could not be created.
+ */
+int create_file(const std::string& path)
+{
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error(
+            std::string("Could not create recording: ") + path + " (" + std::strerror(errno) + ")");
+    }
+    return fd;
+}
+
+} // namespace
+
+FrameRecorder::FrameRecorder(const std::string& path)
+    : format(path.ends_with(".y4m") ? Format::Y4m : Format::Raw)
+    , frames(CAPACITY * SLOT_BYTES)
+{
+    fd = create_file(path);
+    std::string header;
+    if (format == Format::Y4m) {
+        // The frame rate is the exact one of the Game Boy, about 59.73 Hz.
+        header = "YUV4MPEG2 W" + std::to_string(PPU::SCREEN_WIDTH) + " H" + std::to_string(PPU::SCREEN_HEIGHT)
+            + " F4194304:70224 Ip A1:1 Cmono\n";
+    } else {
+        try {
+            index_fd = create_file(path + ".idx");
+        } catch (...) {
+            ::close(fd);
+            throw;
+        }
+        header = "frame,offset\n";
+    }
+    if (!write_all(format == Format::Y4m ? fd : index_fd, header)) {
+        std::string error = std::strerror(errno);
+        ::close(fd);
+        if (index_fd >= 0)
+            ::close(index_fd);
+        throw std::runtime_error("Could not write recording: " + path + " (" + error + ")");
+    }
+    writer = std::thread(&FrameRecorder::write_loop, this);
+}
+
+FrameRecorder::~FrameRecorder()
+{
+    close();
+}
+
+void FrameRecorder::close()
+{
+    if (!writer.joinable())
+        return;
+    closing.store(true, std::memory_order_release);
+    wakeups.fetch_add(1, std::memory_order_release);
+    wakeups.notify_one();
+    writer.join();
+    ::close(fd);
+    if (index_fd >= 0)
+        ::close(index_fd);
+}
+
+bool FrameRecorder::push(const uint8_t* pixels, PixelFormat pixel_format, size_t stride, uint64_t frame)
+{
+    uint32_t index = tail.load(std::memory_order_relaxed);
+    if (index - head.load(std::memory_order_acquire) == CAPACITY or failed() or !writer.joinable()) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    uint8_t* slot = frames.data() + (index % CAPACITY) * SLOT_BYTES;
+    size_t row_bytes = PPU::SCREEN_WIDTH * bytes_per_pixel(pixel_format);
+    for (int y = 0; y < PPU::SCREEN_HEIGHT; ++y)
+        std::memcpy(slot + y * row_bytes, pixels + y * stride, row_bytes);
+    slots[index % CAPACITY] = { frame, pixel_format };
+    tail.store(index + 1, std::memory_order_release);
+    // Waking the writer thread up costs a system call, it is only done once a batch is queued.
+    if ((index + 1) % BATCH_FRAMES == 0) {
+        wakeups.fetch_add(1, std::memory_order_release);
+        wakeups.notify_one();
+    }
+    return true;
+}
+
+void FrameRecorder::write_loop()
+{
+    std::string batch, index;
+    uint32_t batch_frames = 0;
+    uint64_t offset = 0;
+    auto flush = [&]() {
+        bool ok = !failed() and write_all(fd, batch) and (index_fd < 0 or write_all(index_fd, index));
+        if (ok) {
+            written.fetch_add(batch_frames, std::memory_order_relaxed);
+        } else {
+            write_failed.store(true, std::memory_order_relaxed);
+            dropped.fetch_add(batch_frames, std::memory_order_relaxed);
+        }
+        batch.clear();
+        index.clear();
+        batch_frames = 0;
+    };
+
+    while (true) {
+        // Loaded first, so that a frame pushed or a close asked for after the checks is not missed.
+        uint32_t wakeup = wakeups.load(std::memory_order_acquire);
+        bool closed = closing.load(std::memory_order_acquire);
+        uint32_t position = head.load(std::memory_order_relaxed);
+        if (position == tail.load(std::memory_order_acquire)) {
+            if (closed)
+                break;
+            wakeups.wait(wakeup, std::memory_order_acquire);
+            continue;
+        }
+
+        const Slot& slot = slots[position % CAPACITY];
+        if (format == Format::Y4m) {
+            batch += "FRAME\n";
+        } else {
+            index += std::to_string(slot.frame) + "," + std::to_string(offset) + "\n";
+            offset += FRAME_PIXELS;
+        }
+        size_t start = batch.size();
+        batch.resize(start + FRAME_PIXELS);
+        to_gray(frames.data() + (position % CAPACITY) * SLOT_BYTES, slot.format,
+            reinterpret_cast<uint8_t*>(batch.data() + start));
+        head.store(position + 1, std::memory_order_release);
+
+        if (++batch_frames == BATCH_FRAMES)
+            flush();
+    }
+    if (batch_frames > 0)
+        flush();
+}
+
+bool FrameRecorder::write_all(int file, const std::string& data)
+{
+    for (size_t done = 0; done < data.size();) {
+        ssize_t count = write(file, data.data() + done, data.size() - done);
+        if (count < 0 and errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+        done += count;
+    }
+    return true;
+}
@@ -1,10 +1,12 @@
 #include "gameboy.hpp"
+#include <memory>
 #include <string>
 
 GameBoy::GameBoy()
-    : memory()
+    : scheduler()
+    , memory(scheduler)
     , cpu(memory)
-    , ppu()
+    , ppu(memory, scheduler)
 {
 }
 
@@ -13,10 +15,139 @@ void GameBoy::load_rom(const std::string& filename)
     memory.load_rom(filename);
 }
 
-void GameBoy::run()
+const CartridgeInfo& GameBoy::cartridge_info() const
 {
-    while (true) {
+    return memory.cartridge_info();
+}
+
+void GameBoy::set_save_flush_interval(std::chrono::milliseconds interval)
+{
+    memory.set_save_flush_interval(interval);
+}
+
+#ifdef GAMEBOY_WATCHPOINTS
+int GameBoy::add_watchpoint(uint16_t first, uint16_t last, uint8_t kinds, Memory::WatchCallback callback)
+{
+    return memory.add_watchpoint(first, last, kinds, std::move(callback));
+}
+
+void GameBoy::remove_watchpoint(int id)
+{
+    memory.remove_watchpoint(id);
+}
+#endif
+
+#ifdef GAMEBOY_HEATMAP
+void GameBoy::export_heatmap(const std::string& path) const
+{
+    memory.export_heatmap(path);
+}
+#endif
+
+void GameBoy::run(const std::function<void()>& frame_done)
+{
+    running.store(true, std::memory_order_relaxed);
+    while (running.load(std::memory_order_relaxed)) {
+        if (!run_frame())
+            return;
+        if (frame_done)
+            frame_done();
+    }
+}
+
+bool GameBoy::run_frame()
+{
+#ifdef GAMEBOY_WATCHPOINTS
+    memory.clear_break();
+#endif
+    // A frame ends when the PPU enters VBlank, or after a frame duration while the LCD is off.
+    uint64_t frame = ppu.frame_count();
+    uint64_t frame_end = scheduler.now() + CYCLES_PER_FRAME;
+    while (ppu.frame_count() == frame and scheduler.now() < frame_end) {
         cpu.cycle();
-        ppu.cycle();
+        scheduler.tick();
+#ifdef GAMEBOY_WATCHPOINTS
+        if (memory.break_requested()) {
+            ppu.finish_drawing();
+            return false;
+        }
+#endif
     }
+    ppu.finish_drawing();
+    if (observation_buffer) {
+        observation_buffer->end_frame(ppu.frame_count() != frame and ppu.rendering());
+        ppu.set_gray_output(observation_buffer->frame_target());
+    }
+    return true;
+}
+
+void GameBoy::stop()
+{
+    running.store(false, std::memory_order_relaxed);
+}
+
+void GameBoy::enable_observations(const Observations::Config& config)
+{
+    auto buffer = std::make_unique<Observations>(config);
+    ppu.set_gray_output(buffer->frame_target());
+    observation_buffer = std::move(buffer);
+}
+
+void GameBoy::disable_observations()
+{
+    ppu.set_gray_output(nullptr);
+    observation_buffer.reset();
+}
+
+GameBoy::Footprint GameBoy::footprint() const
+{
+    size_t heap_bytes = memory.heap_bytes() + ppu.heap_bytes();
+    if (observation_buffer)
+        heap_bytes += observation_buffer->heap_bytes();
+    return { sizeof(GameBoy), heap_bytes, memory.shared_bytes() + CPU::shared_bytes() };
+}
+
+void GameBoy::set_renderer(PPU::Renderer renderer)
+{
+    ppu.set_renderer(renderer);
+}
+
+void GameBoy::set_render_skip(bool skip)
+{
+    ppu.set_render_skip(skip);
+}
+
+void GameBoy::render_next_frames(uint32_t count)
+{
+    ppu.render_next_frames(count);
+}
+
+void GameBoy::set_render_thread(bool enabled)
+{
+    ppu.set_render_thread(enabled);
+}
+
+void GameBoy::set_frame_output(uint8_t* pixels, PixelFormat format, size_t stride)
+{
+    ppu.set_output(pixels, format, stride);
+}
+
+const PPU::Framebuffer& GameBoy::framebuffer() const
+{
+    return ppu.framebuffer();
+}
+
+uint32_t GameBoy::frame_hash() const
+{
+    return ppu.frame_hash();
+}
+
+bool GameBoy::frame_repeated() const
+{
+    return ppu.frame_repeated();
+}
+
+PageBitmap GameBoy::take_dirty_pages()
+{
+    return memory.take_dirty_pages();
 }
@@ -0,0 +1,307 @@
+#include "graphics.hpp"
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+/**
+ * @brief Builds the table spreading the 8 bits of a bitplane byte over 8 bytes, leftmost pixel first.
+ */
+constexpr std::array<uint64_t, 256> make_spread_table()
+{
+    std::array<uint64_t, 256> table {};
+    for (unsigned byte = 0; byte < 256; ++byte)
+        for (unsigned px = 0; px < 8; ++px)
+            if (byte & (0x80 >> px))
+                table[byte] |= uint64_t(1) << (px * 8);
+    return table;
+}
+
+constexpr std::array<uint64_t, 256> spread_table = make_spread_table();
+
+/**
+ * @brief Table-driven decoding, the pixels being the bytes of a little-endian word.
+ */
+void decode_tile_rows_scalar(const uint8_t* planes, size_t rows, uint8_t* pixels)
+{
+    for (size_t row = 0; row < rows; ++row) {
+        uint64_t row_pixels = spread_table[planes[row * 2]] | spread_table[planes[row * 2 + 1]] << 1;
+        std::memcpy(pixels + row * 8, &row_pixels, 8);
+    }
+}
+
+void map_palettes_scalar(const uint8_t* codes, size_t count, const PaletteTable& table, uint8_t* shades)
+{
+    for (size_t i = 0; i < count; ++i)
+        shades[i] = table[codes[i]];
+}
+
+/**
+ * @brief Lookup per pixel, the pixels being bytes wide.
+ */
+template <size_t bytes>
+void write_pixels_scalar(const uint8_t* codes, size_t count, const PixelTable& table, uint8_t* pixels)
+{
+    for (size_t i = 0; i < count; ++i)
+        for (size_t byte = 0; byte < bytes; ++byte)
+            pixels[i * bytes + byte] = static_cast<uint8_t>(table[codes[i]] >> (byte * 8));
+}
+
+/**
+ * @brief Gives the table of the byte-th byte of the pixels.
+ */
+PaletteTable byte_plane(const PixelTable& table, size_t byte)
+{
+    PaletteTable plane {};
+    for (size_t code = 0; code < table.size(); ++code)
+        plane[code] = static_cast<uint8_t>(table[code] >> (byte * 8));
+    return plane;
+}
+
+#if defined(__x86_64__)
+/**
+ * @brief Decodes 8 rows per iteration: each bitplane byte is broadcast to the 8 bytes of its row, then the bit of
+ * each pixel is tested against a mask.
+ */
+__attribute__((target("ssse3"))) void decode_tile_rows_ssse3(const uint8_t* planes, size_t rows, uint8_t* pixels)
+{
+    const __m128i bits = _mm_set1_epi64x(static_cast<int64_t>(0x0102040810204080));
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i two = _mm_set1_epi8(2);
+    // The low bitplanes of the first two rows are the bytes 0 and 2 of the input, their high bitplanes follow them.
+    const __m128i lo_select = _mm_set_epi64x(0x0202020202020202, 0);
+    const __m128i hi_select = _mm_add_epi8(lo_select, one);
+    size_t row = 0;
+    for (; row + 8 <= rows; row += 8) {
+        __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes + row * 2));
+        for (int pair = 0; pair < 4; ++pair) {
+            __m128i offset = _mm_set1_epi8(static_cast<char>(pair * 4));
+            __m128i lo = _mm_shuffle_epi8(input, _mm_add_epi8(lo_select, offset));
+            __m128i hi = _mm_shuffle_epi8(input, _mm_add_epi8(hi_select, offset));
+            lo = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(lo, bits), bits), one);
+            hi = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(hi, bits), bits), two);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + (row + pair * 2) * 8), _mm_or_si128(lo, hi));
+        }
+    }
+    decode_tile_rows_scalar(planes + row * 2, rows - row, pixels + row * 8);
+}
+
+/**
+ * @brief Same as the SSSE3 version, with 4 rows per shuffle: the 16 input bytes are broadcast to both lanes.
+ */
+__attribute__((target("avx2"))) void decode_tile_rows_avx2(const uint8_t* planes, size_t rows, uint8_t* pixels)
+{
+    const __m256i bits = _mm256_set1_epi64x(static_cast<int64_t>(0x0102040810204080));
+    const __m256i one = _mm256_set1_epi8(1);
+    const __m256i two = _mm256_set1_epi8(2);
+    // Lane 0 gets the rows 0 and 1 of the group, lane 1 the rows 2 and 3. Rows 4-7 use the same masks plus 8.
+    const __m256i lo_select = _mm256_set_epi64x(0x0606060606060606, 0x0404040404040404, 0x0202020202020202, 0);
+    const __m256i hi_select = _mm256_add_epi8(lo_select, one);
+    const __m256i next_group = _mm256_set1_epi8(8);
+    size_t row = 0;
+    for (; row + 8 <= rows; row += 8) {
+        __m256i input
+            = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(planes + row * 2)));
+        for (int group = 0; group < 2; ++group) {
+            __m256i offset = group ? next_group : _mm256_setzero_si256();
+            __m256i lo = _mm256_shuffle_epi8(input, _mm256_add_epi8(lo_select, offset));
+            __m256i hi = _mm256_shuffle_epi8(input, _mm256_add_epi8(hi_select, offset));
+            lo = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(lo, bits), bits), one);
+            hi = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(hi, bits), bits), two);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels + (row + group * 4) * 8), _mm256_or_si256(lo, hi));
+        }
+    }
+    decode_tile_rows_scalar(planes + row * 2, rows - row, pixels + row * 8);
+}
+
+__attribute__((target("ssse3"))) void map_palettes_ssse3(
+    const uint8_t* codes, size_t count, const PaletteTable& table, uint8_t* shades)
+{
+    const __m128i lookup = _mm_loadu_si128(reinterpret_cast<const __m128i*>(table.data()));
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(shades + i), _mm_shuffle_epi8(lookup, input));
+    }
+    map_palettes_scalar(codes + i, count - i, table, shades + i);
+}
+
+__attribute__((target("avx2"))) void map_palettes_avx2(
+    const uint8_t* codes, size_t count, const PaletteTable& table, uint8_t* shades)
+{
+    const __m256i lookup
+        = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(table.data())));
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(shades + i), _mm256_shuffle_epi8(lookup, input));
+    }
+    map_palettes_ssse3(codes + i, count - i, table, shades + i);
+}
+
+/**
+ * @brief Looks up each byte of 16 pixels with its own shuffle, then interleaves the results.
+ */
+__attribute__((target("ssse3"))) void write_pixels16_ssse3(
+    const uint8_t* codes, size_t count, const PixelTable& table, uint8_t* pixels)
+{
+    PaletteTable low = byte_plane(table, 0), high = byte_plane(table, 1);
+    const __m128i low_lookup = _mm_loadu_si128(reinterpret_cast<const __m128i*>(low.data()));
+    const __m128i high_lookup = _mm_loadu_si128(reinterpret_cast<const __m128i*>(high.data()));
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + i));
+        __m128i lo = _mm_shuffle_epi8(low_lookup, input);
+        __m128i hi = _mm_shuffle_epi8(high_lookup, input);
+        __m128i* output = reinterpret_cast<__m128i*>(pixels + i * 2);
+        _mm_storeu_si128(output, _mm_unpacklo_epi8(lo, hi));
+        _mm_storeu_si128(output + 1, _mm_unpackhi_epi8(lo, hi));
+    }
+    write_pixels_scalar<2>(codes + i, count - i, table, pixels + i * 2);
+}
+
+__attribute__((target("ssse3"))) void write_pixels32_ssse3(
+    const uint8_t* codes, size_t count, const PixelTable& table, uint8_t* pixels)
+{
+    __m128i lookups[4];
+    for (size_t byte = 0; byte < 4; ++byte) {
+        PaletteTable plane = byte_plane(table, byte);
+        lookups[byte] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(plane.data()));
+    }
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + i));
+        __m128i b0 = _mm_shuffle_epi8(lookups[0], input);
+        __m128i b1 = _mm_shuffle_epi8(lookups[1], input);
+        __m128i b2 = _mm_shuffle_epi8(lookups[2], input);
+        __m128i b3 = _mm_shuffle_epi8(lookups[3], input);
+        __m128i b01_lo = _mm_unpacklo_epi8(b0, b1), b01_hi = _mm_unpackhi_epi8(b0, b1);
+        __m128i b23_lo = _mm_unpacklo_epi8(b2, b3), b23_hi = _mm_unpackhi_epi8(b2, b3);
+        __m128i* output = reinterpret_cast<__m128i*>(pixels + i * 4);
+        _mm_storeu_si128(output, _mm_unpacklo_epi16(b01_lo, b23_lo));
+        _mm_storeu_si128(output + 1, _mm_unpackhi_epi16(b01_lo, b23_lo));
+        _mm_storeu_si128(output + 2, _mm_unpacklo_epi16(b01_hi, b23_hi));
+        _mm_storeu_si128(output + 3, _mm_unpackhi_epi16(b01_hi, b23_hi));
+    }
+    write_pixels_scalar<4>(codes + i, count - i, table, pixels + i * 4);
+}
+#endif
+
+using DecodeTileRows = void (*)(const uint8_t*, size_t, uint8_t*);
+using MapPalettes = void (*)(const uint8_t*, size_t, const PaletteTable&, uint8_t*);
+using WritePixels = void (*)(const uint8_t*, size_t, const PixelTable&, uint8_t*);
+
+/**
+ * @brief Picks the fastest decoding supported by the running CPU.
+ */
+DecodeTileRows select_decode_tile_rows()
+{
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("avx2"))
+        return decode_tile_rows_avx2;
+    if (__builtin_cpu_supports("ssse3"))
+        return decode_tile_rows_ssse3;
+#endif
+    return decode_tile_rows_scalar;
+}
+
+/**
+ * @brief Picks the fastest palette mapping supported by the running CPU.
+ */
+MapPalettes select_map_palettes()
+{
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("avx2"))
+        return map_palettes_avx2;
+    if (__builtin_cpu_supports("ssse3"))
+        return map_palettes_ssse3;
+#endif
+    return map_palettes_scalar;
+}
+
+/**
+ * @brief Picks the fastest pixel writing supported by the running CPU, for pixels of 2 or 4 bytes.
+ */
+template <size_t bytes>
+WritePixels select_write_pixels()
+{
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("ssse3"))
+        return bytes == 2 ? write_pixels16_ssse3 : write_pixels32_ssse3;
+#endif
+    return write_pixels_scalar<bytes>;
+}
+
+/**
+ * @brief Colors of the 4 shades, from white to black.
+ */
+constexpr std::array<uint8_t, 4> shade_gray = { 0xff, 0xaa, 0x55, 0x00 };
+
+} // namespace
+
+void decode_tile_rows(const uint8_t* planes, size_t rows, uint8_t* pixels)
+{
+    static const DecodeTileRows decode = select_decode_tile_rows();
+    decode(planes, rows, pixels);
+}
+
+PaletteTable make_palette_table(uint8_t bgp, uint8_t obp0, uint8_t obp1)
+{
+    PaletteTable table {};
+    for (int color = 0; color < 4; ++color) {
+        table[color] = (bgp >> (color * 2)) & 0x03;
+        table[4 + color] = (obp0 >> (color * 2)) & 0x03;
+        table[8 + color] = (obp1 >> (color * 2)) & 0x03;
+    }
+    return table;
+}
+
+void map_palettes(const uint8_t* codes, size_t count, const PaletteTable& table, uint8_t* shades)
+{
+    static const MapPalettes map = select_map_palettes();
+    map(codes, count, table, shades);
+}
+
+PixelTable make_pixel_table(const PaletteTable& palettes, PixelFormat format)
+{
+    PixelTable table {};
+    for (size_t code = 0; code < table.size(); ++code) {
+        uint8_t shade = palettes[code] & 0x03;
+        uint32_t gray = shade_gray[shade];
+        switch (format) {
+        case PixelFormat::Shade2:
+            table[code] = shade;
+            break;
+        case PixelFormat::Gray8:
+            table[code] = gray;
+            break;
+        case PixelFormat::Rgb565:
+            table[code] = (gray >> 3) << 11 | (gray >> 2) << 5 | gray >> 3;
+            break;
+        case PixelFormat::Rgba8888:
+            table[code] = 0xff000000 | gray << 16 | gray << 8 | gray;
+            break;
+        }
+    }
+    return table;
+}
+
+void write_pixels(const uint8_t* codes, size_t count, const PixelTable& table, PixelFormat format, uint8_t* pixels)
+{
+    static const WritePixels write16 = select_write_pixels<2>();
+    static const WritePixels write32 = select_write_pixels<4>();
+    switch (bytes_per_pixel(format)) {
+    case 2:
+        write16(codes, count, table, pixels);
+        break;
+    case 4:
+        write32(codes, count, table, pixels);
+        break;
+    default:
+        map_palettes(codes, count, byte_plane(table, 0), pixels);
+    }
+}
@@ -0,0 +1,146 @@
+#include "hash.hpp"
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+namespace {
+
+constexpr uint32_t CRC32C_POLY = 0x82f63b78; /**< Castagnoli polynomial, bit-reversed. */
+
+/**
+ * @brief Builds the byte-wise lookup table of the scalar implementation.
+ */
+constexpr std::array<uint32_t, 256> make_crc32c_table()
+{
+    std::array<uint32_t, 256> table {};
+    for (uint32_t byte = 0; byte < 256; ++byte) {
+        uint32_t crc = byte;
+        for (int bit = 0; bit < 8; ++bit)
+            crc = crc & 1 ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+        table[byte] = crc;
+    }
+    return table;
+}
+
+constexpr std::array<uint32_t, 256> crc32c_table = make_crc32c_table();
+
+/**
+ * @brief Multiplies two polynomials modulo the CRC polynomial, in reflected bit order.
+ */
+constexpr uint32_t multiply_mod_poly(uint32_t a, uint32_t b)
+{
+    uint32_t product = 0;
+    for (uint32_t mask = 1u << 31; mask != 0; mask >>= 1) {
+        if (a & mask)
+            product ^= b;
+        b = b & 1 ? (b >> 1) ^ CRC32C_POLY : b >> 1;
+    }
+    return product;
+}
+
+/**
+ * @brief Builds the table of x^(2^k) modulo the CRC polynomial.
+ */
+constexpr std::array<uint32_t, 64> make_x2n_table()
+{
+    std::array<uint32_t, 64> table {};
+    uint32_t p = 1u << 30; // x^1
+    for (uint32_t& entry : table) {
+        entry = p;
+        p = multiply_mod_poly(p, p);
+    }
+    return table;
+}
+
+constexpr std::array<uint32_t, 64> x2n_table = make_x2n_table();
+
+/**
+ * @brief Gives the CRC of a state shifted by some zero bytes, i.e., multiplied by x^(8 * bytes).
+ */
+uint32_t shift_crc(uint32_t crc, size_t bytes)
+{
+    uint32_t p = 1u << 31; // x^0
+    for (size_t k = 3; bytes != 0; bytes >>= 1, ++k)
+        if (bytes & 1)
+            p = multiply_mod_poly(x2n_table[k & 63], p);
+    return multiply_mod_poly(p, crc);
+}
+
+/**
+ * @brief Table-driven CRC32C update, without the initial and final inversions.
+ */
+uint32_t crc32c_scalar(uint32_t crc, const uint8_t* data, size_t size)
+{
+    for (size_t i = 0; i < size; ++i)
+        crc = crc32c_table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return crc;
+}
+
+#if defined(__x86_64__)
+/**
+ * @brief Hardware CRC32C update, without the initial and final inversions.
+ *
+ * The crc32 instruction has a latency of 3 cycles but a throughput of one per cycle, so large buffers are split into
+ * three lanes hashed in parallel, then combined by shifting the partial CRCs.
+ */
+__attribute__((target("sse4.2"))) uint32_t crc32c_sse42(uint32_t crc, const uint8_t* data, size_t size)
+{
+    constexpr size_t MIN_LANE_SIZE = 4096;
+    size_t lane_size = (size / 3) & ~size_t(7);
+    if (lane_size >= MIN_LANE_SIZE) {
+        const uint8_t* lane0 = data;
+        const uint8_t* lane1 = data + lane_size;
+        const uint8_t* lane2 = data + 2 * lane_size;
+        uint64_t crc0 = crc, crc1 = 0, crc2 = 0;
+        for (size_t i = 0; i < lane_size; i += 8) {
+            uint64_t word0, word1, word2;
+            std::memcpy(&word0, lane0 + i, 8);
+            std::memcpy(&word1, lane1 + i, 8);
+            std::memcpy(&word2, lane2 + i, 8);
+            crc0 = _mm_crc32_u64(crc0, word0);
+            crc1 = _mm_crc32_u64(crc1, word1);
+            crc2 = _mm_crc32_u64(crc2, word2);
+        }
+        crc = shift_crc(static_cast<uint32_t>(crc0), lane_size) ^ static_cast<uint32_t>(crc1);
+        crc = shift_crc(crc, lane_size) ^ static_cast<uint32_t>(crc2);
+        data += 3 * lane_size;
+        size -= 3 * lane_size;
+    }
+
+    uint64_t crc64 = crc;
+    for (; size >= 8; data += 8, size -= 8) {
+        uint64_t word;
+        std::memcpy(&word, data, 8);
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = static_cast<uint32_t>(crc64);
+    for (; size > 0; ++data, --size)
+        crc = _mm_crc32_u8(crc, *data);
+    return crc;
+}
+#endif
+
+using Crc32cUpdate = uint32_t (*)(uint32_t, const uint8_t*, size_t);
+
+/**
+ * @brief Picks the fastest implementation supported by the running CPU.
+ */
+Crc32cUpdate select_crc32c()
+{
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("sse4.2"))
+        return crc32c_sse42;
+#endif
+    return crc32c_scalar;
+}
+
+} // namespace
+
+uint32_t crc32c(const uint8_t* data, size_t size, uint32_t crc)
+{
+    static const Crc32cUpdate update = select_crc32c();
+    return ~update(~crc, data, size);
+}
@@ -1,14 +1,195 @@
+#include "frame_recorder.hpp"
 #include "gameboy.hpp"
+#include "scaler.hpp"
+#include <algorithm>
+#include <bit>
+#include <csignal>
+#include <filesystem>
 #include <iostream>
+#include <memory>
+#include <string>
+#ifdef GAMEBOY_SDL
+#include "presenter.hpp"
+#include "triple_buffer.hpp"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#endif
+
+static GameBoy* running_gameboy = nullptr; /**< Instance stopped by the signal handler. */
+
+/**
+ * @brief Stops the emulation on SIGINT/SIGTERM so that it exits normally and the save file gets flushed.
+ */
+static void handle_stop_signal(int)
+{
+    if (running_gameboy)
+        running_gameboy->stop();
+}
+
+/**
+ * @brief Prints the memory used by an instance after a few seconds of emulation, and the memory it wrote per frame.
+ *
+ * @param gameboy Instance with a loaded ROM.
+ */
+static void report_footprint(GameBoy& gameboy)
+{
+    constexpr int FRAMES = 600;
+    size_t total_written = 0, max_written = 0;
+    int frames = 0;
+    gameboy.take_dirty_pages();
+    while (frames < FRAMES and gameboy.run_frame()) {
+        size_t written = 0;
+        for (uint64_t word : gameboy.take_dirty_pages())
+            written += std::popcount(word) * 0x100;
+        total_written += written;
+        max_written = std::max(max_written, written);
+        ++frames;
+    }
+
+    GameBoy::Footprint footprint = gameboy.footprint();
+    std::cout << "Object: " << footprint.object_bytes << " bytes\n"
+              << "Heap: " << footprint.heap_bytes << " bytes\n"
+              << "Shared: " << footprint.shared_bytes << " bytes\n";
+    // Only the writes are tracked: the pages read, e.g., the ROM and the tile data, are not counted.
+    if (frames > 0)
+        std::cout << "Written per frame: " << total_written / frames << " bytes on average, " << max_written
+                  << " at most (" << frames << " frames, 256-byte pages written by the program)" << std::endl;
+}
+
+#ifdef GAMEBOY_SDL
+/**
+ * @brief Runs the emulation at the speed of the Game Boy on its own thread, and shows its frames in a window until the
+ * window is closed.
+ *
+ * @param gameboy Instance with a loaded ROM.
+ * @param title Title of the window.
+ * @param filter Upscaling filter applied to the frames shown.
+ * @param recorder Recording receiving the frames, nullptr if not recording.
+ */
+static void run_windowed(GameBoy& gameboy, const std::string& title, ScaleFilter filter, FrameRecorder* recorder)
+{
+    using Frames = std::chrono::duration<int64_t, std::ratio<GameBoy::CYCLES_PER_FRAME, GameBoy::CYCLES_PER_SECOND>>;
+    constexpr size_t ROW_BYTES = PPU::SCREEN_WIDTH * bytes_per_pixel(PixelFormat::Rgba8888);
+
+    Presenter presenter(title, filter);
+    TripleBuffer frames(ROW_BYTES * PPU::SCREEN_HEIGHT);
+    std::atomic<bool> closed { false };
+    std::thread emulation([&]() {
+        // The frames are drawn straight into the back buffer, and the pace is kept against the start time so that
+        // late frames are caught up with. GameBoy::run() returns on a stop() call, from the signal handler or once
+        // the window is closed.
+        auto start = std::chrono::steady_clock::now();
+        int64_t frame = 0;
+        gameboy.set_frame_output(frames.back(), PixelFormat::Rgba8888, ROW_BYTES);
+        gameboy.run([&]() {
+            if (recorder)
+                recorder->push(frames.back(), PixelFormat::Rgba8888, ROW_BYTES, frame);
+            frames.publish();
+            gameboy.set_frame_output(frames.back(), PixelFormat::Rgba8888, ROW_BYTES);
+            if (closed.load(std::memory_order_relaxed))
+                gameboy.stop();
+            else
+                std::this_thread::sleep_until(start + Frames(++frame));
+        });
+        gameboy.set_frame_output(nullptr, PixelFormat::Shade2, 0);
+        // Closes the window when the emulation stopped on its own.
+        presenter.request_close();
+    });
+    presenter.run(frames);
+    closed.store(true, std::memory_order_relaxed);
+    emulation.join();
+}
+#endif
+
+/**
+ * @brief Gives the upscaling filter named on the command line.
+ *
+ * @param name Name of the filter: none, scale2x, scale3x or smooth2x.
+ * @return The filter.
+ * @throws std::runtime_error if the name is unknown.
+ */
+static ScaleFilter parse_filter(const std::string& name)
+{
+    if (name == "none")
+        return ScaleFilter::None;
+    if (name == "scale2x")
+        return ScaleFilter::Scale2x;
+    if (name == "scale3x")
+        return ScaleFilter::Scale3x;
+    if (name == "smooth2x")
+        return ScaleFilter::Smooth2x;
+    throw std::runtime_error("Unknown filter: " + name);
+}
 
 int main(int argc, char* argv[])
 {
-    if (argc != 2) {
-        std::cout << "Usage: " << argv[0] << " <ROM path>" << std::endl;
+    bool footprint = false;
+    [[maybe_unused]] bool headless = false;
+    [[maybe_unused]] ScaleFilter filter = ScaleFilter::None;
+    std::string record_path;
+    int arg = 1;
+    for (; arg < argc - 1; ++arg) {
+        std::string option = argv[arg];
+        if (option == "--footprint")
+            footprint = true;
+        else if (option == "--headless")
+            headless = true;
+        else if (option == "--record" and arg + 1 < argc - 1)
+            record_path = argv[++arg];
+        else if (option == "--filter" and arg + 1 < argc - 1)
+            filter = parse_filter(argv[++arg]);
+        else
+            break;
+    }
+    if (arg != argc - 1) {
+        std::cout << "Usage: " << argv[0]
+                  << " [--footprint] [--headless] [--filter none|scale2x|scale3x|smooth2x]"
+                     " [--record <.y4m or raw path>] <ROM path>"
+                  << std::endl;
         throw std::runtime_error("ROM file not specified.");
     }
+    const char* rom_path = argv[argc - 1];
     GameBoy gameboy {};
-    gameboy.load_rom(argv[1]);
-    gameboy.run();
+    gameboy.load_rom(rom_path);
+    if (footprint) {
+        report_footprint(gameboy);
+        return 0;
+    }
+
+    std::unique_ptr<FrameRecorder> recorder;
+    if (!record_path.empty())
+        recorder = std::make_unique<FrameRecorder>(record_path);
+    uint64_t frame = 0;
+    auto record_frame = [&]() {
+        recorder->push(gameboy.framebuffer().data(), PixelFormat::Shade2, PPU::SCREEN_WIDTH, frame++);
+    };
+
+    running_gameboy = &gameboy;
+    std::signal(SIGINT, handle_stop_signal);
+    std::signal(SIGTERM, handle_stop_signal);
+#ifdef GAMEBOY_SDL
+    if (!headless) {
+        const std::string& title = gameboy.cartridge_info().title;
+        run_windowed(gameboy, title.empty() ? "GameBoy" : title, filter, recorder.get());
+    } else {
+        gameboy.run(recorder ? record_frame : std::function<void()>());
+    }
+#else
+    gameboy.run(recorder ? record_frame : std::function<void()>());
+#endif
+    running_gameboy = nullptr;
+
+    if (recorder) {
+        recorder->close();
+        std::cout << "Recorded " << recorder->written_frames() << " frames, " << recorder->dropped_frames()
+                  << " dropped" << (recorder->failed() ? " (write error)" : "") << std::endl;
+    }
+
+#ifdef GAMEBOY_HEATMAP
+    std::filesystem::path heatmap_path(rom_path);
+    heatmap_path.replace_extension(".heatmap.csv");
+    gameboy.export_heatmap(heatmap_path.string());
+#endif
     return 0;
 }
@@ -1,51 +1,62 @@
 #include "memory.hpp"
 #include <cstdint>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <string>
 
-Memory::Memory()
+Memory::Memory(Scheduler& scheduler)
+    : scheduler(scheduler)
 {
+    scheduler.set_handler(Event::OamDmaEnd, [this]() { end_oam_dma(); });
+    stale_tile_rows.fill(~uint64_t(0));
+    update_memory_map();
+
     io_regs.fill(0x00); // Initialize all I/O registers to 0x00
     io_regs[0x00] = 0xCF; // P1
     io_regs[0x01] = 0x00; // SB: Serial Data
     io_regs[0x02] = 0x7E; // SC: Serial Control for DMG
     io_regs[0x07] = 0xF8; // TAC
+    io_regs[0x41] = 0x80; // STAT: bit 7 always reads as 1 on the DMG
     io_regs[0x44] = 0x90; // LY
-    write_byte(0xFF05, 0x00); // TIMA
-    write_byte(0xFF06, 0x00); // TMA
-    write_byte(0xFF07, 0x00); // TAC
-    write_byte(0xFF10, 0x80); // NR10
-    write_byte(0xFF11, 0xBF); // NR11
-    write_byte(0xFF12, 0xF3); // NR12
-    write_byte(0xFF14, 0xBF); // NR14
-    write_byte(0xFF16, 0x3F); // NR21
-    write_byte(0xFF17, 0x00); // NR22
-    write_byte(0xFF19, 0xBF); // NR24
-    write_byte(0xFF1A, 0x7F); // NR30
-    write_byte(0xFF1B, 0xFF); // NR31
-    write_byte(0xFF1C, 0x9F); // NR32
-    write_byte(0xFF1E, 0xBF); // NR33
-    write_byte(0xFF20, 0xFF); // NR41
-    write_byte(0xFF21, 0x00); // NR42
-    write_byte(0xFF22, 0x00); // NR43
-    write_byte(0xFF23, 0xBF); // NR30
-    write_byte(0xFF24, 0x77); // NR50
-    write_byte(0xFF25, 0xF3); // NR51
-    write_byte(0xFF26, 0xF1); // NR52 (GB) or 0xF0 (SGB)
-    write_byte(0xFF40, 0x91); // LCDC
-    write_byte(0xFF42, 0x00); // SCY
-    write_byte(0xFF43, 0x00); // SCX
-    write_byte(0xFF45, 0x00); // LYC
-    write_byte(0xFF47, 0xFC); // BGP
-    write_byte(0xFF48, 0xFF); // OBP0
-    write_byte(0xFF49, 0xFF); // OBP1
-    write_byte(0xFF4A, 0x00); // WY
-    write_byte(0xFF4B, 0x00); // WX
-    write_byte(0xFFFF, 0x00); // IE
+    write8(0xFF05, 0x00); // TIMA
+    write8(0xFF06, 0x00); // TMA
+    write8(0xFF07, 0x00); // TAC
+    write8(0xFF10, 0x80); // NR10
+    write8(0xFF11, 0xBF); // NR11
+    write8(0xFF12, 0xF3); // NR12
+    write8(0xFF14, 0xBF); // NR14
+    write8(0xFF16, 0x3F); // NR21
+    write8(0xFF17, 0x00); // NR22
+    write8(0xFF19, 0xBF); // NR24
+    write8(0xFF1A, 0x7F); // NR30
+    write8(0xFF1B, 0xFF); // NR31
+    write8(0xFF1C, 0x9F); // NR32
+    write8(0xFF1E, 0xBF); // NR33
+    write8(0xFF20, 0xFF); // NR41
+    write8(0xFF21, 0x00); // NR42
+    write8(0xFF22, 0x00); // NR43
+    write8(0xFF23, 0xBF); // NR30
+    write8(0xFF24, 0x77); // NR50
+    write8(0xFF25, 0xF3); // NR51
+    write8(0xFF26, 0xF1); // NR52 (GB) or 0xF0 (SGB)
+    write8(0xFF40, 0x91); // LCDC
+    write8(0xFF42, 0x00); // SCY
+    write8(0xFF43, 0x00); // SCX
+    write8(0xFF45, 0x00); // LYC
+    write8(0xFF47, 0xFC); // BGP
+    write8(0xFF48, 0xFF); // OBP0
+    write8(0xFF49, 0xFF); // OBP1
+    write8(0xFF4A, 0x00); // WY
+    write8(0xFF4B, 0x00); // WX
+    write8(0xFFFF, 0x00); // IE
 
     interrupt_reg = 0x00; // IE: Interrupt Enable
+#ifdef GAMEBOY_HEATMAP
+    heatmap = {}; // The power-up values are not accesses of the program
+#endif
 }
 
 void Memory::load_rom(const std::string& path)
@@ -55,23 +66,234 @@ void Memory::load_rom(const std::string& path)
 
     uintmax_t size = std::filesystem::file_size(path);
     std::ifstream file(path, std::ios::binary);
-    rom.resize(size);
-    file.read(reinterpret_cast<char*>(rom.data()), size);
+    std::vector<uint8_t> image(size);
+    file.read(reinterpret_cast<char*>(image.data()), size);
+
+    cartridge = parse_cartridge(image);
+    rom_image = share_rom(std::move(image), cartridge.hash);
+    rom = std::span<const uint8_t>(*rom_image);
+
+    save_file.reset();
+    if (cartridge.ram_size > 0 and cartridge.has_battery) {
+        std::filesystem::path save_path(path);
+        save_path.replace_extension(".sav");
+        save_file = std::make_unique<SaveFile>(save_path.string(), cartridge.ram_size, save_flush_interval);
+        ram.clear();
+        sram = std::span<uint8_t>(save_file->data(), save_file->size());
+    } else {
+        ram.assign(cartridge.ram_size, 0x00);
+        sram = std::span<uint8_t>(ram);
+    }
+
+    update_memory_map();
+}
+
+void Memory::set_save_flush_interval(std::chrono::milliseconds interval)
+{
+    save_flush_interval = interval;
+    if (save_file)
+        save_file->set_flush_interval(interval);
+}
+
+size_t Memory::heap_bytes() const
+{
+    size_t bytes = ram.capacity();
+    if (save_file)
+        bytes += sizeof(SaveFile) + save_file->size();
+#ifdef GAMEBOY_WATCHPOINTS
+    bytes += watchpoints.capacity() * sizeof(Watchpoint);
+#endif
+    return bytes;
 }
 
-uint8_t Memory::read_byte(uint16_t address)
+void Memory::update_memory_map()
 {
-    return at(address);
+    for (unsigned page = 0x00; page <= 0xff; ++page) {
+        uint16_t address = page << 8;
+        const uint8_t* read_page = readable_page(page);
+        uint8_t* write_page = nullptr;
+        // Tile data writes also have to flag the tile row for the PPU cache, so they take the slow path. All the VRAM
+        // writes do when they are logged.
+        if ((is_in_between(address, 0x9800, 0x9fff) and !video_log) or is_in_between(address, 0xc000, 0xdfff))
+            write_page = const_cast<uint8_t*>(read_page);
+        // Battery-backed writes also have to flag the save file, so they take the slow path.
+        else if (is_in_between(address, 0xa000, 0xbfff) and !save_file)
+            write_page = const_cast<uint8_t*>(read_page);
+        // Echo RAM writes are flagged dirty on the WRAM page, so they take the slow path.
+        // OAM and the 0xff page mix several areas, they always take the slow path.
+
+        if (oam_dma_active)
+            read_page = write_page = nullptr;
+
+        read_map[page] = read_page;
+        write_map[page] = write_page;
+#ifdef GAMEBOY_WATCHPOINTS
+        exec_map[page] = read_map[page];
+        if (watched_pages[page] & WATCH_READ)
+            read_map[page] = nullptr;
+        if (watched_pages[page] & WATCH_WRITE)
+            write_map[page] = nullptr;
+        if (watched_pages[page] & WATCH_EXECUTE)
+            exec_map[page] = nullptr;
+#endif
+    }
 }
 
-uint8_t& Memory::at(uint16_t address)
+const uint8_t* Memory::readable_page(uint8_t page)
 {
+    uint16_t address = page << 8;
     if (is_in_between(address, 0x0, 0x7fff))
-        return rom[address];
+        return address + 0x100u <= rom.size() ? rom.data() + address : nullptr;
+    else if (is_in_between(address, 0x8000, 0x9fff))
+        return vram.data() + (address - 0x8000);
+    else if (is_in_between(address, 0xa000, 0xbfff))
+        return address - 0xa000u + 0x100u <= sram.size() ? sram.data() + (address - 0xa000) : nullptr;
+    else if (is_in_between(address, 0xc000, 0xdfff))
+        return wram.data() + (address - 0xc000);
+    else if (is_in_between(address, 0xe000, 0xfdff))
+        return wram.data() + (address - 0xe000);
+    return nullptr;
+}
+
+void Memory::set_video_log(VideoLog* log)
+{
+    video_log = log;
+    update_memory_map();
+}
+
+void Memory::start_oam_dma(uint8_t source)
+{
+    io_regs[DMA_ADDR - 0xff00] = source;
+
+    // Sources from 0xe0 do not reach OAM or I/O, the transfer reads WRAM through its echo instead.
+    const uint8_t* page = readable_page(source < 0xe0 ? source : source - 0x20);
+    if (page)
+        std::memcpy(oam.data(), page, oam.size());
+    else
+        oam.fill(0xff);
+    mark_dirty(0xfe00);
+    ++oam_writes;
+    if (video_log)
+        for (uint16_t offset = 0; offset < oam.size(); ++offset)
+            video_log->write(scheduler.now(), 0xfe00 + offset, oam[offset]);
+
+    oam_dma_active = true;
+    update_memory_map();
+    scheduler.schedule(Event::OamDmaEnd, OAM_DMA_CYCLES);
+}
+
+void Memory::end_oam_dma()
+{
+    oam_dma_active = false;
+    update_memory_map();
+}
+
+uint8_t Memory::read_slow(uint16_t address)
+{
+    if (oam_dma_active and address < 0xff00)
+        return 0xff;
+    uint8_t value = read_area(address);
+#ifdef GAMEBOY_WATCHPOINTS
+    if (watched_pages[address >> 8] & WATCH_READ)
+        check_watchpoints(address, value, WATCH_READ);
+#endif
+    return value;
+}
+
+#ifdef GAMEBOY_WATCHPOINTS
+uint8_t Memory::fetch_opcode_slow(uint16_t address)
+{
+    uint8_t value = oam_dma_active and address < 0xff00 ? 0xff : read_area(address);
+    if (watched_pages[address >> 8] & WATCH_EXECUTE)
+        check_watchpoints(address, value, WATCH_EXECUTE);
+    return value;
+}
+
+int Memory::add_watchpoint(uint16_t first, uint16_t last, uint8_t kinds, WatchCallback callback)
+{
+    int id = next_watch_id++;
+    // The callbacks of an access are called from watchpoints, which is left untouched until they all returned.
+    if (checking_watchpoints) {
+        added_watchpoints.push_back({ id, first, last, kinds, std::move(callback) });
+        return id;
+    }
+    watchpoints.push_back({ id, first, last, kinds, std::move(callback) });
+    update_watched_pages();
+    return id;
+}
+
+void Memory::remove_watchpoint(int id)
+{
+    if (checking_watchpoints) {
+        removed_watchpoints.push_back(id);
+        return;
+    }
+    std::erase_if(watchpoints, [id](const Watchpoint& watchpoint) { return watchpoint.id == id; });
+    update_watched_pages();
+}
+
+void Memory::update_watched_pages()
+{
+    watched_pages.fill(0);
+    for (const Watchpoint& watchpoint : watchpoints)
+        for (unsigned page = watchpoint.first >> 8; page <= static_cast<unsigned>(watchpoint.last >> 8); ++page)
+            watched_pages[page] |= watchpoint.kinds;
+    update_memory_map();
+}
+
+void Memory::check_watchpoints(uint16_t address, uint8_t value, uint8_t kind)
+{
+    checking_watchpoints = true;
+    for (const Watchpoint& watchpoint : watchpoints) {
+        if (!(watchpoint.kinds & kind) or !is_in_between(address, watchpoint.first, watchpoint.last))
+            continue;
+        if (!watchpoint.callback or watchpoint.callback(address, value, kind))
+            watch_break = true;
+    }
+    checking_watchpoints = false;
+
+    // The watchpoints added and removed by the callbacks apply from the next access.
+    if (added_watchpoints.empty() and removed_watchpoints.empty())
+        return;
+    for (Watchpoint& watchpoint : added_watchpoints)
+        watchpoints.push_back(std::move(watchpoint));
+    added_watchpoints.clear();
+    for (int id : removed_watchpoints)
+        std::erase_if(watchpoints, [id](const Watchpoint& watchpoint) { return watchpoint.id == id; });
+    removed_watchpoints.clear();
+    update_watched_pages();
+}
+#endif
+
+#ifdef GAMEBOY_HEATMAP
+void Memory::export_heatmap(const std::string& path) const
+{
+    std::ofstream file(path);
+    if (!file)
+        throw std::runtime_error(std::string("Could not write heatmap file: ") + path);
+
+    file << "first,last,reads,writes,executes\n";
+    for (size_t block = 0; block < heatmap.size(); ++block) {
+        const std::array<uint64_t, 3>& counts = heatmap[block];
+        if (counts[HEAT_READ] == 0 and counts[HEAT_WRITE] == 0 and counts[HEAT_EXECUTE] == 0)
+            continue;
+        unsigned first = block < 0xff ? block << 8 : 0xff00 + (block - 0xff);
+        unsigned last = block < 0xff ? first + 0xff : first;
+        file << std::hex << std::setfill('0') << "0x" << std::setw(4) << first << ",0x" << std::setw(4) << last
+             << std::dec << ',' << counts[HEAT_READ] << ',' << counts[HEAT_WRITE] << ',' << counts[HEAT_EXECUTE]
+             << '\n';
+    }
+}
+#endif
+
+uint8_t Memory::read_area(uint16_t address)
+{
+    if (is_in_between(address, 0x0, 0x7fff))
+        return address < rom.size() ? rom[address] : default_return;
     else if (is_in_between(address, 0x8000, 0x9fff))
         return vram[address - 0x8000];
     else if (is_in_between(address, 0xa000, 0xbfff))
-        return ram[address - 0xa000];
+        return address - 0xa000u < sram.size() ? sram[address - 0xa000] : default_return;
     else if (is_in_between(address, 0xc000, 0xdfff))
         return wram[address - 0xc000];
     else if (is_in_between(address, 0xe000, 0xfdff))
@@ -87,22 +309,75 @@ uint8_t& Memory::at(uint16_t address)
     return default_return;
 }
 
-void Memory::write_byte(uint16_t address, uint8_t value)
+void Memory::write_slow(uint16_t address, uint8_t value)
 {
-    if (is_in_between(address, 0x8000, 0x9fff))
+#ifdef GAMEBOY_WATCHPOINTS
+    if (watched_pages[address >> 8] & WATCH_WRITE)
+        check_watchpoints(address, value, WATCH_WRITE);
+#endif
+    if (oam_dma_active and address < 0xff00)
+        return;
+
+    if (is_in_between(address, 0x8000, 0x9fff)) {
         vram[address - 0x8000] = value;
-    else if (is_in_between(address, 0xa000, 0xbfff))
-        ram[address - 0xa000] = value;
-    else if (is_in_between(address, 0xc000, 0xdfff))
+        mark_dirty(address);
+        if (address < 0x9800) {
+            uint16_t row = (address - 0x8000) >> 1;
+            stale_tile_rows[row >> 6] |= uint64_t(1) << (row & 0x3f);
+        }
+        if (video_log)
+            video_log->write(scheduler.now(), address, value);
+    } else if (is_in_between(address, 0xa000, 0xbfff)) {
+        if (address - 0xa000u < sram.size()) {
+            sram[address - 0xa000] = value;
+            mark_dirty(address);
+            if (save_file)
+                save_file->mark_dirty(address - 0xa000);
+        }
+    } else if (is_in_between(address, 0xc000, 0xdfff)) {
         wram[address - 0xc000] = value;
-    else if (is_in_between(address, 0xe000, 0xfdff))
+        mark_dirty(address);
+    } else if (is_in_between(address, 0xe000, 0xfdff)) {
         wram[address - 0xe000] = value;
-    else if (is_in_between(address, 0xfe00, 0xfe9f))
+        mark_dirty(address - 0x2000);
+    } else if (is_in_between(address, 0xfe00, 0xfe9f)) {
         oam[address - 0xfe00] = value;
-    else if (is_in_between(address, 0xff00, 0xff7f))
+        mark_dirty(address);
+        ++oam_writes;
+        if (video_log)
+            video_log->write(scheduler.now(), address, value);
+    } else if (address == DMA_ADDR) {
+        start_oam_dma(value);
+    } else if (address == P1_ADDR) {
+        // Only the selection bits are writable. No button is reported as pressed, a game reading them as all
+        // pressed would reset itself.
+        io_regs[P1_ADDR - 0xff00] = 0xc0 | (value & 0x30) | 0x0f;
+    } else if (address == STAT_ADDR) {
+        // The mode and LY=LYC bits are maintained by the PPU, bit 7 is unused and reads as 1. The new interrupt
+        // enables can raise the STAT interrupt right away.
+        io_regs[STAT_ADDR - 0xff00] = 0x80 | (value & 0x78) | (io_regs[STAT_ADDR - 0xff00] & 0x07);
+        scheduler.schedule(Event::LcdStat, 1);
+    } else if (address == LY_ADDR) {
+        return; // Read-only
+    } else if (is_in_between(address, 0xff00, 0xff7f)) {
+        if (is_in_between(address, LCD_REGISTERS_ADDR, LCD_REGISTERS_END)) {
+            if (lcd_write_count < lcd_write_log.size()) {
+                uint8_t index = address - LCD_REGISTERS_ADDR;
+                lcd_write_log[lcd_write_count++] = { scheduler.now(), index, io_regs[address - 0xff00], value };
+            }
+            if (video_log)
+                video_log->write(scheduler.now(), address, value);
+        }
         io_regs[address - 0xff00] = value;
-    else if (is_in_between(address, 0xff80, 0xfffe))
+        // Seen by the PPU at the end of this cycle, as if it checked LCDC and LYC every cycle.
+        if (address == LCDC_ADDR)
+            scheduler.schedule(Event::LcdControl, 1);
+        else if (address == LYC_ADDR)
+            scheduler.schedule(Event::LcdStat, 1);
+    } else if (is_in_between(address, 0xff80, 0xfffe)) {
         hram[address - 0xff80] = value;
-    else if (address == 0xFFFF)
+        mark_dirty(address);
+    } else if (address == 0xFFFF) {
         interrupt_reg = value;
+    }
 }
@@ -0,0 +1,235 @@
+#include "observations.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+/**
+ * @brief Sums the weighted source rows of an output row, column by column.
+ *
+ * Arguments: frame, frame it is max-pooled with (nullptr if none), first row, row count, weights of the rows,
+ * receives the PPU::SCREEN_WIDTH sums. The weights of a row sum up to at most PPU::SCREEN_HEIGHT, so the sums fit in
+ * 16 bits.
+ */
+using SumRows = void (*)(const uint8_t*, const uint8_t*, size_t, size_t, const uint16_t*, uint16_t*);
+
+void sum_rows_scalar(
+    const uint8_t* frame, const uint8_t* pooled, size_t first, size_t count, const uint16_t* weights, uint16_t* sums)
+{
+    std::fill_n(sums, PPU::SCREEN_WIDTH, 0);
+    for (size_t k = 0; k < count; ++k) {
+        const uint8_t* row = frame + (first + k) * PPU::SCREEN_WIDTH;
+        const uint8_t* other = pooled ? pooled + (first + k) * PPU::SCREEN_WIDTH : row;
+        for (size_t x = 0; x < PPU::SCREEN_WIDTH; ++x)
+            sums[x] += weights[k] * std::max(row[x], other[x]);
+    }
+}
+
+#if defined(__x86_64__)
+/**
+ * @brief 16 columns at a time, the pooling being a byte max and the weighting a 16-bit multiply-add.
+ */
+__attribute__((target("sse2"))) void sum_rows_sse2(
+    const uint8_t* frame, const uint8_t* pooled, size_t first, size_t count, const uint16_t* weights, uint16_t* sums)
+{
+    static_assert(PPU::SCREEN_WIDTH % 16 == 0);
+    __m128i zero = _mm_setzero_si128();
+    for (size_t x = 0; x < PPU::SCREEN_WIDTH; x += 16) {
+        __m128i low = zero, high = zero;
+        for (size_t k = 0; k < count; ++k) {
+            size_t offset = (first + k) * PPU::SCREEN_WIDTH + x;
+            __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(frame + offset));
+            if (pooled)
+                pixels = _mm_max_epu8(pixels, _mm_loadu_si128(reinterpret_cast<const __m128i*>(pooled + offset)));
+            __m128i weight = _mm_set1_epi16(static_cast<int16_t>(weights[k]));
+            low = _mm_add_epi16(low, _mm_mullo_epi16(_mm_unpacklo_epi8(pixels, zero), weight));
+            high = _mm_add_epi16(high, _mm_mullo_epi16(_mm_unpackhi_epi8(pixels, zero), weight));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(sums + x), low);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(sums + x + 8), high);
+    }
+}
+#endif
+
+/**
+ * @brief Averages the sums of the rows into the output pixels of a row.
+ *
+ * Arguments: sums of the rows (the ones past PPU::SCREEN_WIDTH being 0, up to twice as many), first sum of each
+ * output pixel, weights, number of sums per output pixel, width of the output, receives the output pixels.
+ */
+using AverageColumns = void (*)(const uint16_t*, const uint16_t*, const uint16_t*, size_t, size_t, uint8_t*);
+
+constexpr uint32_t AREA = PPU::SCREEN_WIDTH * PPU::SCREEN_HEIGHT; /**< Sum of the weights of an output pixel. */
+
+void average_columns_scalar(const uint16_t* sums, const uint16_t* firsts, const uint16_t* weights, size_t count,
+    size_t width, uint8_t* output)
+{
+    for (size_t x = 0; x < width; ++x) {
+        uint32_t sum = 0;
+        for (size_t i = 0; i < count; ++i)
+            sum += weights[x * count + i] * sums[firsts[x] + i];
+        output[x] = static_cast<uint8_t>((sum + AREA / 2) / AREA);
+    }
+}
+
+#if defined(__x86_64__)
+/**
+ * @brief 8 output pixels at a time when they have 4 sums each: a 16-bit multiply-add per pair of pixels, then a
+ * division by the area done as a shift and a 16-bit multiply, exact for these sums.
+ */
+__attribute__((target("sse2"))) void average_columns_sse2(const uint16_t* sums, const uint16_t* firsts,
+    const uint16_t* weights, size_t count, size_t width, uint8_t* output)
+{
+    if (count != 4) {
+        average_columns_scalar(sums, firsts, weights, count, width, output);
+        return;
+    }
+
+    // The multiply-add is signed, the sums are moved to the int16_t range and the offset is added back to the
+    // totals, as weights * 0x8000 with the weights summing up to SCREEN_WIDTH.
+    alignas(16) int16_t signed_sums[PPU::SCREEN_WIDTH * 2];
+    __m128i offset = _mm_set1_epi16(-0x8000);
+    for (size_t x = 0; x < PPU::SCREEN_WIDTH * 2; x += 8) {
+        __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sums + x));
+        _mm_store_si128(reinterpret_cast<__m128i*>(signed_sums + x), _mm_xor_si128(values, offset));
+    }
+
+    // x / 23040 = (x >> 9) / 45, and y / 45 = ((y * 46604) >> 16) >> 5 for y below 2^14.
+    static_assert(AREA == 512 * 45);
+    __m128i total_offset = _mm_set1_epi32(0x8000 * PPU::SCREEN_WIDTH + AREA / 2);
+    __m128i reciprocal = _mm_set1_epi16(static_cast<int16_t>(46604));
+    size_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i totals[2];
+        for (size_t half = 0; half < 2; ++half) {
+            __m128i products[2];
+            for (size_t pair = 0; pair < 2; ++pair) {
+                size_t column = x + half * 4 + pair * 2;
+                __m128i values = _mm_unpacklo_epi64(
+                    _mm_loadl_epi64(reinterpret_cast<const __m128i*>(signed_sums + firsts[column])),
+                    _mm_loadl_epi64(reinterpret_cast<const __m128i*>(signed_sums + firsts[column + 1])));
+                products[pair] = _mm_madd_epi16(
+                    values, _mm_loadu_si128(reinterpret_cast<const __m128i*>(weights + column * 4)));
+            }
+            // Each product is half of the total of a column.
+            __m128 low = _mm_castsi128_ps(products[0]), high = _mm_castsi128_ps(products[1]);
+            __m128i total = _mm_add_epi32(_mm_castps_si128(_mm_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0))),
+                _mm_castps_si128(_mm_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1))));
+            totals[half] = _mm_srli_epi32(_mm_add_epi32(total, total_offset), 9);
+        }
+        __m128i quotients = _mm_srli_epi16(_mm_mulhi_epu16(_mm_packs_epi32(totals[0], totals[1]), reciprocal), 5);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(output + x), _mm_packus_epi16(quotients, quotients));
+    }
+    average_columns_scalar(sums, firsts + x, weights + x * count, count, width - x, output + x);
+}
+#endif
+
+SumRows select_sum_rows()
+{
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("sse2"))
+        return sum_rows_sse2;
+#endif
+    return sum_rows_scalar;
+}
+
+AverageColumns select_average_columns()
+{
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("sse2"))
+        return average_columns_sse2;
+#endif
+    return average_columns_scalar;
+}
+
+} // namespace
+
+Observations::Observations(const Config& config)
+    : config(config)
+    , observation_bytes(static_cast<size_t>(config.width) * config.height)
+{
+    if (config.width < 1 or config.width > PPU::SCREEN_WIDTH or config.height < 1
+        or config.height > PPU::SCREEN_HEIGHT) {
+        throw std::runtime_error(
+            "Invalid observation size: " + std::to_string(config.width) + "x" + std::to_string(config.height));
+    }
+    if (config.history == 0 or config.frames_per_observation == 0)
+        throw std::runtime_error("Observation history and period must not be 0");
+
+    frames.resize(FRAME_BYTES * 2);
+    ring.resize(observation_bytes * config.history * 2);
+    row_taps = make_taps(PPU::SCREEN_HEIGHT, config.height, 1);
+    // 4 columns per output pixel at least, which the vector averaging works on.
+    column_taps = make_taps(PPU::SCREEN_WIDTH, config.width, 4);
+}
+
+Observations::Taps Observations::make_taps(int source, int output, size_t min_count)
+{
+    // The output pixel j covers [j * source, (j + 1) * source) and the source pixel i covers [i * output,
+    // (i + 1) * output), both in 1/output of a source pixel. All the output pixels get as many source pixels, so that
+    // the loops over them always run the same number of times.
+    Taps taps { {}, {}, std::max<size_t>((source + output - 1) / output + 1, min_count) };
+    for (int j = 0; j < output; ++j) {
+        int start = j * source, end = (j + 1) * source;
+        int first = start / output;
+        taps.firsts.push_back(static_cast<uint16_t>(first));
+        for (int i = first; i < first + static_cast<int>(taps.count); ++i) {
+            int overlap = std::min(end, (i + 1) * output) - std::max(start, i * output);
+            taps.weights.push_back(static_cast<uint16_t>(std::max(overlap, 0)));
+        }
+    }
+    return taps;
+}
+
+size_t Observations::heap_bytes() const
+{
+    size_t taps = row_taps.firsts.capacity() + row_taps.weights.capacity() + column_taps.firsts.capacity()
+        + column_taps.weights.capacity();
+    return sizeof(Observations) + frames.capacity() + ring.capacity() + taps * sizeof(uint16_t);
+}
+
+void Observations::end_frame(bool drawn)
+{
+    if (drawn)
+        target ^= 1;
+    if (++frames_ended % config.frames_per_observation == 0)
+        observe();
+}
+
+std::span<const uint8_t> Observations::stack() const
+{
+    // The observation n is stored at the slots n % history and n % history + history, so the last history ones are
+    // always the ones following the slot of the oldest.
+    size_t start = (observations % config.history) * observation_bytes;
+    return { ring.data() + start, observation_bytes * config.history };
+}
+
+void Observations::observe()
+{
+    static const SumRows sum_rows = select_sum_rows();
+    static const AverageColumns average_columns = select_average_columns();
+
+    // The last drawn frame is the one not drawn next, the frame before it is still in the other buffer.
+    const uint8_t* frame = frames.data() + (target ^ 1) * FRAME_BYTES;
+    const uint8_t* pooled = config.max_pool ? frames.data() + target * FRAME_BYTES : nullptr;
+    uint8_t* output = ring.data() + (observations % config.history) * observation_bytes;
+
+    // The area average is separable: the weighted source rows of an output row are summed, then the weighted sums of
+    // the source columns of each output pixel. The taps of the last columns can go past the frame, with zero weights.
+    alignas(16) uint16_t sums[PPU::SCREEN_WIDTH * 2] {};
+    for (int y = 0; y < config.height; ++y) {
+        size_t first = row_taps.firsts[y];
+        size_t count = std::min(row_taps.count, PPU::SCREEN_HEIGHT - first);
+        sum_rows(frame, pooled, first, count, row_taps.weights.data() + y * row_taps.count, sums);
+        average_columns(sums, column_taps.firsts.data(), column_taps.weights.data(), column_taps.count, config.width,
+            output + y * config.width);
+    }
+    std::memcpy(output + observation_bytes * config.history, output, observation_bytes);
+    ++observations;
+}
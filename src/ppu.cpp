@@ -1,6 +1,232 @@
-#include "gameboy.hpp"
+#include "ppu.hpp"
+#include "render_thread.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
 
-void PPU::cycle()
+PPU::PPU(Memory& memory, Scheduler& scheduler)
+    : memory(memory)
+    , scheduler(scheduler)
+    , lines(memory.video_view())
 {
-    return;
+    scheduler.set_handler(Event::LcdControl, [this]() { check_lcd_control(); });
+    // The LY=LYC comparison and the STAT interrupt line only run while the LCD is on.
+    scheduler.set_handler(Event::LcdStat, [this]() {
+        if (lcd_enabled)
+            update_stat();
+    });
+    scheduler.set_handler(Event::PpuMode, [this]() { step(); });
+    memory.set_io_register(LY_ADDR, ly);
+    set_mode(Mode::OamScan);
+    schedule_step();
+}
+
+PPU::~PPU() = default;
+
+void PPU::check_lcd_control()
+{
+    bool enabled = memory.io_register(LCDC_ADDR) & 0x80;
+    if (enabled == lcd_enabled)
+        return;
+    lcd_enabled = enabled;
+    if (!enabled) {
+        // The screen goes blank and the PPU restarts from the first line when the LCD is turned back on.
+        scheduler.cancel(Event::PpuMode);
+        finish_drawing();
+        dot = 0;
+        ly = 0;
+        start_frame();
+        memory.set_io_register(LY_ADDR, ly);
+        set_mode(Mode::HBlank);
+        output.blank();
+    } else {
+        // The line starts with this dot.
+        dot = 1;
+        set_mode(Mode::OamScan);
+        schedule_step();
+    }
+}
+
+void PPU::step()
+{
+    switch (mode) {
+    case Mode::OamScan:
+        start_drawing();
+        break;
+    case Mode::Drawing:
+        if (current_renderer == Renderer::PixelFifo) {
+            step_fifo();
+        } else {
+            if (render_frame)
+                render_line();
+            set_mode(Mode::HBlank);
+        }
+        break;
+    default:
+        next_line();
+    }
+    schedule_step();
+}
+
+void PPU::schedule_step()
+{
+    uint16_t next_dot = DOTS_PER_LINE;
+    if (mode == Mode::OamScan)
+        next_dot = OAM_SCAN_DOTS;
+    else if (mode == Mode::Drawing)
+        next_dot = current_renderer == Renderer::PixelFifo ? dot + 1 : OAM_SCAN_DOTS + DRAWING_DOTS;
+    scheduler.schedule(Event::PpuMode, next_dot - dot);
+    dot = next_dot;
+}
+
+void PPU::start_frame()
+{
+    window_line = 0;
+    window_y_reached = false;
+    current_renderer = next_renderer;
+    output.reset_hash();
+    render_frame = !skip_rendering or frames_to_render > 0;
+    if (frames_to_render > 0)
+        --frames_to_render;
+
+    if (render_frame and current_renderer == Renderer::PixelFifo) {
+        lines.allocate_caches();
+    } else if (!render_frame and release_caches) {
+        // The last drawn lines were waited for on entering VBlank, the render thread is idle.
+        release_caches = false;
+        lines.release_caches();
+        if (render_thread)
+            render_thread->release_caches();
+    }
+}
+
+void PPU::start_drawing()
+{
+    if (ly == memory.io_register(WY_ADDR))
+        window_y_reached = true;
+
+    set_mode(Mode::Drawing);
+    drawing_start = scheduler.now();
+    memory.clear_lcd_writes();
+    // The pixel FIFO renderer needs the objects even on skipped frames, as they lengthen the drawing.
+    if (current_renderer == Renderer::PixelFifo) {
+        line_objects = &lines.objects(ly);
+        start_fifo_line();
+    }
+}
+
+void PPU::set_mode(Mode new_mode)
+{
+    mode = new_mode;
+    uint8_t stat = memory.io_register(STAT_ADDR);
+    memory.set_io_register(STAT_ADDR, (stat & ~0x03) | static_cast<uint8_t>(mode));
+    update_stat();
+}
+
+void PPU::next_line()
+{
+    dot = 0;
+    ++ly;
+    if (ly == LINES_PER_FRAME) {
+        ly = 0;
+        start_frame();
+    }
+    memory.set_io_register(LY_ADDR, ly);
+
+    if (ly == SCREEN_HEIGHT) {
+        ++frames;
+        if (render_frame) {
+            finish_drawing();
+            repeated_frame = output.hash() == last_frame_hash;
+            last_frame_hash = output.hash();
+        }
+        memory.request_interrupt(Memory::INTERRUPT_VBLANK);
+        set_mode(Mode::VBlank);
+    } else if (ly < SCREEN_HEIGHT) {
+        set_mode(Mode::OamScan);
+    } else {
+        update_stat();
+    }
+}
+
+void PPU::update_stat()
+{
+    bool coincidence = ly == memory.io_register(LYC_ADDR);
+    uint8_t stat = (memory.io_register(STAT_ADDR) & ~0x04) | (coincidence ? 0x04 : 0x00);
+    memory.set_io_register(STAT_ADDR, stat);
+
+    bool line = (coincidence and (stat & 0x40)) or (mode == Mode::HBlank and (stat & 0x08))
+        or (mode == Mode::VBlank and (stat & 0x10)) or (mode == Mode::OamScan and (stat & 0x20));
+    if (line and !stat_line)
+        memory.request_interrupt(Memory::INTERRUPT_STAT);
+    stat_line = line;
+}
+
+void PPU::render_line()
+{
+    // The pixels are output one per dot once the first one is out, after the ones dropped for the fine scroll.
+    std::span<const Memory::LcdWrite> lcd_writes = memory.lcd_writes();
+    uint8_t scx = memory.io_register(SCX_ADDR);
+    for (const Memory::LcdWrite& write : lcd_writes) {
+        if (write.index == SCX_ADDR - LCDC_ADDR) {
+            scx = write.old_value;
+            break;
+        }
+    }
+    std::array<LineRenderer::RegisterWrite, Memory::LCD_WRITES_KEPT> writes;
+    size_t count = 0;
+    for (const Memory::LcdWrite& write : lcd_writes) {
+        int64_t x = static_cast<int64_t>(write.cycle - drawing_start) - FIRST_PIXEL_DOTS - (scx & 0x07);
+        x = std::clamp<int64_t>(x, 0, SCREEN_WIDTH);
+        writes[count++] = { static_cast<uint8_t>(x), write.index, write.old_value, write.value };
+    }
+
+    // The window shows from the line matching WY, its own line counter only advancing on the lines showing it.
+    std::optional<uint8_t> window;
+    if (window_y_reached) {
+        LineRenderer::LcdRegisters registers;
+        for (size_t i = 0; i < registers.size(); ++i)
+            registers[i] = memory.io_register(LCDC_ADDR + i);
+        window = window_line;
+        if (LineRenderer::window_shown(registers.data(), { writes.data(), count }))
+            ++window_line;
+    }
+
+    if (render_thread)
+        render_thread->draw_line(ly, window, { writes.data(), count });
+    else
+        lines.draw_line(ly, window, { writes.data(), count }, output);
+}
+
+void PPU::set_output(uint8_t* pixels, PixelFormat format, size_t stride)
+{
+    finish_drawing();
+    output.set(pixels, format, stride);
+}
+
+void PPU::set_gray_output(uint8_t* pixels)
+{
+    finish_drawing();
+    output.set_gray(pixels);
+}
+
+void PPU::set_render_thread(bool enabled)
+{
+    if (enabled and !render_thread)
+        render_thread = std::make_unique<RenderThread>(memory, output);
+    else if (!enabled)
+        render_thread.reset();
+}
+
+size_t PPU::heap_bytes() const
+{
+    return output.heap_bytes() + lines.heap_bytes() + (render_thread ? render_thread->heap_bytes() : 0);
+}
+
+void PPU::finish_drawing()
+{
+    if (render_thread)
+        render_thread->wait();
 }
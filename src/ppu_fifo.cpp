@@ -0,0 +1,174 @@
+#include "ppu.hpp"
+#include "graphics.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+void PPU::start_fifo_line()
+{
+    bg_fifo_size = 0;
+    bg_fifo_head = 0;
+    object_fifo.fill({});
+    object_fifo_head = 0;
+    fetch_step = FetchStep::Tile;
+    fetch_dots = 0;
+    fetch_x = 0;
+    lx = 0;
+    discard = memory.io_register(SCX_ADDR) & 0x07;
+    // The first tile fetch of a line is thrown away by the hardware.
+    stall = 6;
+    objects_fetched = 0;
+    window_active = false;
+}
+
+void PPU::step_fifo()
+{
+    uint8_t lcdc = memory.io_register(LCDC_ADDR);
+
+    // Reaching the window restarts the fetcher on the window tile map, the pixels already fetched are dropped.
+    if (!window_active and (lcdc & 0x20) and window_y_reached and lx + 7 >= memory.io_register(WX_ADDR)) {
+        window_active = true;
+        bg_fifo_size = 0;
+        fetch_step = FetchStep::Tile;
+        fetch_dots = 0;
+        fetch_x = 0;
+    }
+
+    // An object starting at the next pixel pauses the output while its row is fetched. The fetch waits for the
+    // background fetcher to complete its tile first.
+    if (stall == 0 and (lcdc & 0x02)) {
+        const std::array<uint8_t, 0xa0>& oam = memory.object_attributes();
+        for (uint8_t i = 0; i < line_objects->count; ++i) {
+            uint8_t object = line_objects->in_oam_order[i];
+            if ((objects_fetched >> i) & 0x1 or oam[object * 4 + 1] > lx + 8)
+                continue;
+            objects_fetched |= 1 << i;
+            if (render_frame)
+                fetch_object(object);
+            uint8_t progress = fetch_step == FetchStep::Push ? 5 : static_cast<uint8_t>(fetch_step) * 2 + fetch_dots;
+            stall += 6 + (stall == 0 ? 5 - std::min<uint8_t>(progress, 5) : 0);
+        }
+    }
+    if (stall > 0) {
+        --stall;
+        return;
+    }
+
+    step_fetcher();
+    if (bg_fifo_size == 0)
+        return;
+
+    uint8_t bg_color = bg_fifo[bg_fifo_head];
+    bg_fifo_head = (bg_fifo_head + 1) & 0x7;
+    --bg_fifo_size;
+    if (discard > 0) {
+        --discard;
+        return;
+    }
+
+    // A skipped frame only keeps the timing: the fetches and the pixel count, not the pixels.
+    if (render_frame)
+        mix_pixel(lcdc, bg_color);
+    object_fifo[object_fifo_head] = {};
+    object_fifo_head = (object_fifo_head + 1) & 0x7;
+
+    if (++lx == SCREEN_WIDTH) {
+        // The palettes were applied pixel by pixel, line_shades already holds them.
+        if (render_frame)
+            output.write_line(ly, line_shades.data(), shade_palette_table);
+        if (window_active)
+            ++window_line;
+        set_mode(Mode::HBlank);
+    }
+}
+
+void PPU::mix_pixel(uint8_t lcdc, uint8_t bg_color)
+{
+    // On the DMG, clearing LCDC bit 0 blanks both the background and the window.
+    if (!(lcdc & 0x01))
+        bg_color = 0;
+    uint8_t shade = (memory.io_register(BGP_ADDR) >> (bg_color * 2)) & 0x03;
+    const ObjectPixel& object = object_fifo[object_fifo_head];
+    // With the BG priority flag, the object only shows over the background color 0.
+    if (object.color != 0 and (lcdc & 0x02) and !((object.flags & 0x80) and bg_color != 0)) {
+        uint8_t palette = memory.io_register(object.flags & 0x10 ? OBP1_ADDR : OBP0_ADDR);
+        shade = (palette >> (object.color * 2)) & 0x03;
+    }
+    line_shades[lx] = shade;
+}
+
+void PPU::step_fetcher()
+{
+    if (fetch_step == FetchStep::Push) {
+        if (bg_fifo_size != 0)
+            return;
+        if (render_frame) {
+            uint8_t planes[2] = { fetch_low, fetch_high };
+            decode_tile_rows(planes, 1, bg_fifo.data());
+        }
+        bg_fifo_head = 0;
+        bg_fifo_size = 8;
+        ++fetch_x;
+        fetch_step = FetchStep::Tile;
+        fetch_dots = 0;
+        return;
+    }
+    if (++fetch_dots < 2)
+        return;
+    fetch_dots = 0;
+
+    // The registers are read at each step, so that the writes made during the line apply to the next tile.
+    const std::array<uint8_t, 0x2000>& vram = memory.video_ram();
+    uint8_t lcdc = memory.io_register(LCDC_ADDR);
+    uint8_t y = window_active ? window_line : memory.io_register(SCY_ADDR) + ly;
+    switch (fetch_step) {
+    case FetchStep::Tile: {
+        uint16_t map;
+        uint8_t column;
+        if (window_active) {
+            map = lcdc & 0x40 ? 0x1c00 : 0x1800;
+            column = fetch_x & 0x1f;
+        } else {
+            map = lcdc & 0x08 ? 0x1c00 : 0x1800;
+            column = (memory.io_register(SCX_ADDR) / 8 + fetch_x) & 0x1f;
+        }
+        fetch_tile = vram[map + (y / 8) * 32 + column];
+        fetch_step = FetchStep::DataLow;
+        break;
+    }
+    case FetchStep::DataLow:
+        fetch_low = vram[LineRenderer::tile_address(lcdc, fetch_tile) + (y % 8) * 2];
+        fetch_step = FetchStep::DataHigh;
+        break;
+    case FetchStep::DataHigh:
+        fetch_high = vram[LineRenderer::tile_address(lcdc, fetch_tile) + (y % 8) * 2 + 1];
+        fetch_step = FetchStep::Push;
+        break;
+    case FetchStep::Push:
+        break;
+    }
+}
+
+void PPU::fetch_object(uint8_t object)
+{
+    const uint8_t* attributes = memory.object_attributes().data() + object * 4;
+    uint8_t lcdc = memory.io_register(LCDC_ADDR);
+    int height = lcdc & 0x04 ? 16 : 8;
+    int left = attributes[1] - 8;
+    uint8_t flags = attributes[3];
+    uint8_t row = ly - (attributes[0] - 16);
+    if (flags & 0x40)
+        row = height - 1 - row;
+    uint8_t tile = height == 16 ? attributes[2] & 0xfe : attributes[2];
+    const uint8_t* pixels = lines.tile_row(tile * 16 + row * 2);
+
+    // The objects fetched first win, only the transparent slots are filled.
+    for (int px = 0; px < 8; ++px) {
+        int slot = left + (flags & 0x20 ? 7 - px : px) - lx;
+        if (slot < 0 or slot >= 8 or pixels[px] == 0)
+            continue;
+        ObjectPixel& pixel = object_fifo[(object_fifo_head + slot) & 0x7];
+        if (pixel.color == 0)
+            pixel = { pixels[px], flags };
+    }
+}
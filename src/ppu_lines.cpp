@@ -0,0 +1,300 @@
+#include "ppu.hpp"
+#include "graphics.hpp"
+#include "hash.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+void PPU::FrameOutput::set(uint8_t* new_pixels, PixelFormat new_format, size_t new_stride)
+{
+    if (!new_pixels) {
+        if (!frame)
+            frame = std::make_unique<Framebuffer>();
+        pixels = frame->data();
+        format = PixelFormat::Shade2;
+        stride = SCREEN_WIDTH;
+        return;
+    }
+    if (new_stride < SCREEN_WIDTH * bytes_per_pixel(new_format))
+        throw std::runtime_error("Output stride smaller than a row: " + std::to_string(new_stride));
+    pixels = new_pixels;
+    format = new_format;
+    stride = new_stride;
+    // The embedder buffer replaces the internal one, which would be 23 KB of each instance for nothing.
+    frame.reset();
+}
+
+const PPU::Framebuffer& PPU::FrameOutput::framebuffer() const
+{
+    static const Framebuffer white {};
+    return frame ? *frame : white;
+}
+
+void PPU::FrameOutput::write_line(uint8_t ly, const uint8_t* codes, const PaletteTable& palettes)
+{
+    uint8_t* row = pixels + ly * stride;
+    write_pixels(codes, SCREEN_WIDTH, make_pixel_table(palettes, format), format, row);
+    if (gray)
+        write_pixels(codes, SCREEN_WIDTH, make_pixel_table(palettes, PixelFormat::Gray8), PixelFormat::Gray8,
+            gray + ly * SCREEN_WIDTH);
+
+    // The shades are hashed rather than the output pixels, so the hash is the same whatever the format.
+    if (format == PixelFormat::Shade2) {
+        line_hash = crc32c(row, SCREEN_WIDTH, line_hash);
+    } else {
+        std::array<uint8_t, SCREEN_WIDTH> shades;
+        map_palettes(codes, SCREEN_WIDTH, palettes, shades.data());
+        line_hash = crc32c(shades.data(), SCREEN_WIDTH, line_hash);
+    }
+}
+
+void PPU::FrameOutput::blank()
+{
+    std::array<uint8_t, SCREEN_WIDTH> codes {};
+    PixelTable white = make_pixel_table(make_palette_table(0, 0, 0), format);
+    for (int ly = 0; ly < SCREEN_HEIGHT; ++ly)
+        write_pixels(codes.data(), SCREEN_WIDTH, white, format, pixels + ly * stride);
+    if (gray)
+        std::fill_n(gray, SCREEN_WIDTH * SCREEN_HEIGHT, 0xff);
+}
+
+void PPU::LineRenderer::draw_line(
+    uint8_t ly, std::optional<uint8_t> window_line, std::span<const RegisterWrite> writes, FrameOutput& output)
+{
+    if (!caches) [[unlikely]]
+        allocate_caches();
+
+    // The line is first drawn as color codes (see PaletteTable), then mapped to the output pixels in one pass.
+    std::array<uint8_t, SCREEN_WIDTH> line;
+    if (writes.empty()) {
+        PaletteTable palettes = draw_codes(ly, window_line, video.lcd_registers, line);
+        output.write_line(ly, line.data(), palettes);
+        return;
+    }
+
+    // Raster effects: the whole line is drawn again for each span, which only keeps its own pixels, mapped to
+    // shades with its own palettes.
+    LcdRegisters registers;
+    std::copy_n(video.lcd_registers, registers.size(), registers.begin());
+    for (auto write = writes.rbegin(); write != writes.rend(); ++write)
+        registers[write->index] = write->old_value;
+    std::array<uint8_t, SCREEN_WIDTH> shades;
+    int x = 0;
+    for (size_t i = 0; i <= writes.size(); ++i) {
+        int end = i < writes.size() ? writes[i].x : SCREEN_WIDTH;
+        if (end > x) {
+            PaletteTable palettes = draw_codes(ly, window_line, registers.data(), line);
+            map_palettes(line.data() + x, end - x, palettes, shades.data() + x);
+            x = end;
+        }
+        if (i < writes.size())
+            registers[writes[i].index] = writes[i].value;
+    }
+    output.write_line(ly, shades.data(), shade_palette_table);
+}
+
+void PPU::LineRenderer::allocate_caches()
+{
+    if (caches)
+        return;
+    caches = std::make_unique<Caches>();
+    // The tiles decoded before the caches were freed are lost, all of them are decoded again.
+    std::fill_n(video.stale_tile_rows, Memory::TILE_ROWS / 64, ~uint64_t(0));
+}
+
+bool PPU::LineRenderer::window_shown(const uint8_t* registers, std::span<const RegisterWrite> writes)
+{
+    LcdRegisters values;
+    std::copy_n(registers, values.size(), values.begin());
+    for (auto write = writes.rbegin(); write != writes.rend(); ++write)
+        values[write->index] = write->old_value;
+
+    // The window shows on a span if it is enabled there and starts before the end of the span.
+    int x = 0;
+    for (size_t i = 0; i <= writes.size(); ++i) {
+        int end = i < writes.size() ? writes[i].x : SCREEN_WIDTH;
+        uint8_t lcdc = values[0];
+        int wx = values[WX_ADDR - LCDC_ADDR];
+        if (end > x and (lcdc & 0x01) and (lcdc & 0x20) and wx < SCREEN_WIDTH + 7 and std::max(wx - 7, 0) < end)
+            return true;
+        x = std::max(x, end);
+        if (i < writes.size())
+            values[writes[i].index] = writes[i].value;
+    }
+    return false;
+}
+
+PaletteTable PPU::LineRenderer::draw_codes(
+    uint8_t ly, std::optional<uint8_t> window_line, const uint8_t* registers, std::array<uint8_t, SCREEN_WIDTH>& line)
+{
+    auto register_value = [registers](uint16_t address) { return registers[address - LCDC_ADDR]; };
+    uint8_t lcdc = register_value(LCDC_ADDR);
+    // On the DMG, clearing LCDC bit 0 blanks both the background and the window.
+    if (lcdc & 0x01)
+        draw_background(ly, window_line, registers, line);
+    else
+        line.fill(0);
+
+    PaletteTable palettes = make_palette_table(
+        register_value(BGP_ADDR), register_value(OBP0_ADDR), register_value(OBP1_ADDR));
+    if (!(lcdc & 0x02))
+        return palettes;
+
+    const uint8_t* oam = video.oam;
+    int height = lcdc & 0x04 ? 16 : 8;
+    const LineObjects& line_objects = objects(ly);
+    std::array<bool, SCREEN_WIDTH> taken {}; // Pixels already claimed by a higher priority object.
+    for (int i = 0; i < line_objects.count; ++i) {
+        const uint8_t* object = oam + line_objects.by_priority[i] * 4;
+        int left = object[1] - 8;
+        uint8_t flags = object[3];
+        uint8_t row = ly - (object[0] - 16);
+        if (flags & 0x40)
+            row = height - 1 - row;
+        uint8_t tile = height == 16 ? object[2] & 0xfe : object[2];
+        const uint8_t* pixels = tile_row(tile * 16 + row * 2);
+
+        uint8_t palette_codes = flags & 0x10 ? 8 : 4;
+        for (int px = 0; px < 8; ++px) {
+            int x = left + (flags & 0x20 ? 7 - px : px);
+            uint8_t color = pixels[px];
+            if (x < 0 or x >= SCREEN_WIDTH or color == 0 or taken[x])
+                continue;
+            taken[x] = true;
+            // With the BG priority flag, the object only shows over the background color 0.
+            if ((flags & 0x80) and line[x] != 0)
+                continue;
+            line[x] = palette_codes + color;
+        }
+    }
+    return palettes;
+}
+
+void PPU::LineRenderer::draw_background(uint8_t ly, std::optional<uint8_t> window_line, const uint8_t* registers,
+    std::array<uint8_t, SCREEN_WIDTH>& line)
+{
+    auto register_value = [registers](uint16_t address) { return registers[address - LCDC_ADDR]; };
+    const uint8_t* vram = video.vram;
+    uint8_t lcdc = register_value(LCDC_ADDR) & 0x79;
+    uint8_t scy = register_value(SCY_ADDR);
+    uint8_t scx = register_value(SCX_ADDR);
+    // Each span of a line decides from its own LCDC and WX values, the window can show on some spans only.
+    if (!(lcdc & 0x20) or register_value(WX_ADDR) >= SCREEN_WIDTH + 7)
+        window_line.reset();
+    uint8_t wx = window_line ? register_value(WX_ADDR) : 0;
+    uint8_t y = scy + ly;
+    const uint8_t* bg_map_row = vram + (lcdc & 0x08 ? 0x1c00 : 0x1800) + (y / 8) * 32;
+    const uint8_t* window_map_row = vram + (lcdc & 0x40 ? 0x1c00 : 0x1800) + (window_line.value_or(0) / 8) * 32;
+
+    // Most lines are drawn from the same tiles and registers frame after frame, the codes are then reused. They are
+    // kept before the palettes and the objects, so that these can change without redrawing the background.
+    BackgroundLine& background = caches->background_lines[ly];
+    if (background.drawn and background.lcdc == lcdc and background.scy == scy and background.scx == scx
+        and background.wx == wx and background.window_line == (window_line ? *window_line : -1)
+        and std::equal(bg_map_row, bg_map_row + 32, background.bg_map_row.begin())
+        and (!window_line or std::equal(window_map_row, window_map_row + 32, background.window_map_row.begin()))
+        and !tiles_changed(background)) {
+        line = background.codes;
+        return;
+    }
+
+    uint64_t tile_blocks = 0;
+    for (int x = 0; x < SCREEN_WIDTH;) {
+        uint8_t bg_x = scx + x;
+        uint16_t address = tile_address(lcdc, bg_map_row[bg_x / 8]) + (y % 8) * 2;
+        tile_blocks |= uint64_t(1) << (address / 128);
+        int count = std::min(8 - bg_x % 8, SCREEN_WIDTH - x);
+        std::copy_n(tile_row(address) + bg_x % 8, count, line.begin() + x);
+        x += count;
+    }
+
+    if (window_line) {
+        int window_x0 = wx - 7;
+        for (int x = std::max(window_x0, 0); x < SCREEN_WIDTH;) {
+            int window_x = x - window_x0;
+            uint16_t address = tile_address(lcdc, window_map_row[window_x / 8]) + (*window_line % 8) * 2;
+            tile_blocks |= uint64_t(1) << (address / 128);
+            int count = std::min(8 - window_x % 8, SCREEN_WIDTH - x);
+            std::copy_n(tile_row(address) + window_x % 8, count, line.begin() + x);
+            x += count;
+        }
+        std::copy_n(window_map_row, 32, background.window_map_row.begin());
+    }
+
+    background.codes = line;
+    std::copy_n(bg_map_row, 32, background.bg_map_row.begin());
+    background.tile_blocks = tile_blocks;
+    background.generation = tile_generation;
+    background.drawn = true;
+    background.lcdc = lcdc;
+    background.scy = scy;
+    background.scx = scx;
+    background.wx = wx;
+    background.window_line = window_line ? *window_line : -1;
+}
+
+bool PPU::LineRenderer::tiles_changed(const BackgroundLine& background)
+{
+    for (uint64_t blocks = background.tile_blocks; blocks != 0; blocks &= blocks - 1) {
+        int block = std::countr_zero(blocks);
+        uint64_t& stale = video.stale_tile_rows[block];
+        if (stale) {
+            stale = 0;
+            refresh_tile_block(block);
+        }
+        if (block_generations[block] > background.generation)
+            return true;
+    }
+    return false;
+}
+
+const PPU::LineRenderer::LineObjects& PPU::LineRenderer::objects(uint8_t ly)
+{
+    // The OAM rarely changes more than once per frame, the object lists are only rebuilt when it does.
+    uint8_t height = lcd_register(LCDC_ADDR) & 0x04 ? 16 : 8;
+    if (*video.oam_generation != object_lines_generation or height != object_lines_height)
+        bucket_objects(height);
+    return object_lines[ly];
+}
+
+void PPU::LineRenderer::bucket_objects(uint8_t height)
+{
+    const uint8_t* oam = video.oam;
+    object_lines_generation = *video.oam_generation;
+    object_lines_height = height;
+
+    // Up to 10 objects per line, taken in OAM order.
+    for (LineObjects& line_objects : object_lines)
+        line_objects.count = 0;
+    for (uint8_t i = 0; i < 40; ++i) {
+        int top = oam[i * 4] - 16;
+        for (int line = std::max(top, 0); line < std::min(top + height, SCREEN_HEIGHT); ++line) {
+            LineObjects& line_objects = object_lines[line];
+            if (line_objects.count < line_objects.in_oam_order.size())
+                line_objects.in_oam_order[line_objects.count++] = i;
+        }
+    }
+
+    // The object with the smallest X wins, then the first one in OAM. An insertion sort keeps the OAM order of equal
+    // X values and, unlike std::stable_sort, does not allocate a buffer: the rebuild runs whenever the OAM changes.
+    for (LineObjects& line_objects : object_lines) {
+        line_objects.by_priority = line_objects.in_oam_order;
+        for (uint8_t i = 1; i < line_objects.count; ++i) {
+            uint8_t object = line_objects.by_priority[i];
+            uint8_t j = i;
+            for (; j > 0 and oam[line_objects.by_priority[j - 1] * 4 + 1] > oam[object * 4 + 1]; --j)
+                line_objects.by_priority[j] = line_objects.by_priority[j - 1];
+            line_objects.by_priority[j] = object;
+        }
+    }
+}
+
+void PPU::LineRenderer::refresh_tile_block(uint16_t block)
+{
+    decode_tile_rows(video.vram + block * 128, 64, caches->tile_cache.data() + block * 64 * 8);
+    block_generations[block] = ++tile_generation;
+}
@@ -0,0 +1,101 @@
+#include "presenter.hpp"
+#include "graphics.hpp"
+#include "ppu.hpp"
+#include <SDL.h>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+constexpr size_t ROW_BYTES = PPU::SCREEN_WIDTH * bytes_per_pixel(PixelFormat::Rgba8888); /**< Size of a frame row. */
+
+} // namespace
+
+Presenter::Presenter(const std::string& title, ScaleFilter filter, int scale)
+    : filter(filter)
+{
+    if (SDL_Init(SDL_INIT_VIDEO) != 0)
+        throw std::runtime_error(std::string("Could not initialize SDL: ") + SDL_GetError());
+
+    window = SDL_CreateWindow(title.c_str(), SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, PPU::SCREEN_WIDTH * scale,
+        PPU::SCREEN_HEIGHT * scale, SDL_WINDOW_RESIZABLE);
+    if (window)
+        renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+    // Without a GPU, the software renderer still does the job.
+    if (window and !renderer)
+        renderer = SDL_CreateRenderer(window, -1, 0);
+    if (renderer) {
+        SDL_RenderSetLogicalSize(renderer, PPU::SCREEN_WIDTH, PPU::SCREEN_HEIGHT);
+        // The bytes of PixelFormat::Rgba8888, whatever the endianness.
+        int factor = scale_factor(filter);
+        texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING,
+            PPU::SCREEN_WIDTH * factor, PPU::SCREEN_HEIGHT * factor);
+    }
+    if (!texture) {
+        std::string error = SDL_GetError();
+        close();
+        throw std::runtime_error("Could not open the window: " + error);
+    }
+
+    SDL_RendererInfo info {};
+    vsync = SDL_GetRendererInfo(renderer, &info) == 0 and (info.flags & SDL_RENDERER_PRESENTVSYNC);
+}
+
+Presenter::~Presenter()
+{
+    close();
+}
+
+void Presenter::close()
+{
+    if (texture)
+        SDL_DestroyTexture(texture);
+    if (renderer)
+        SDL_DestroyRenderer(renderer);
+    if (window)
+        SDL_DestroyWindow(window);
+    texture = nullptr;
+    renderer = nullptr;
+    window = nullptr;
+    SDL_Quit();
+}
+
+void Presenter::run(TripleBuffer& frames)
+{
+    while (true) {
+        SDL_Event event;
+        while (SDL_PollEvent(&event)) {
+            if (event.type == SDL_QUIT)
+                return;
+        }
+
+        bool new_frame = frames.acquire();
+        if (new_frame)
+            upload(frames.front());
+        // Without the vertical sync to wait for, the frames are only presented as they come.
+        if (!vsync and !new_frame) {
+            SDL_Delay(1);
+            continue;
+        }
+        SDL_RenderClear(renderer);
+        SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+        SDL_RenderPresent(renderer);
+    }
+}
+
+void Presenter::request_close()
+{
+    SDL_Event event {};
+    event.type = SDL_QUIT;
+    SDL_PushEvent(&event);
+}
+
+void Presenter::upload(const uint8_t* frame)
+{
+    void* pixels;
+    int pitch;
+    if (SDL_LockTexture(texture, nullptr, &pixels, &pitch) != 0)
+        return;
+    scale_image(frame, PPU::SCREEN_WIDTH, PPU::SCREEN_HEIGHT, ROW_BYTES, filter, static_cast<uint8_t*>(pixels), pitch);
+    SDL_UnlockTexture(texture);
+}
@@ -0,0 +1,63 @@
+#include "render_thread.hpp"
+#include <algorithm>
+
+RenderThread::RenderThread(Memory& memory, PPU::FrameOutput& output)
+    : memory(memory)
+    , output(output)
+    , renderer({ vram.data(), oam.data(), lcd_registers.data(), stale_tile_rows.data(), &oam_writes })
+{
+    Memory::VideoView video = memory.video_view();
+    std::copy_n(video.vram, vram.size(), vram.begin());
+    std::copy_n(video.oam, oam.size(), oam.begin());
+    std::copy_n(video.lcd_registers, lcd_registers.size(), lcd_registers.begin());
+    stale_tile_rows.fill(~uint64_t(0));
+    memory.set_video_log(&log);
+    thread = std::thread(&RenderThread::run, this);
+}
+
+RenderThread::~RenderThread()
+{
+    memory.set_video_log(nullptr);
+    log.close();
+    thread.join();
+}
+
+void RenderThread::run()
+{
+    while (log.wait_for_entries()) {
+        while (const VideoLog::Entry* entry = log.front()) {
+            switch (entry->kind) {
+            case VideoLog::Kind::Write:
+                apply_write(entry->address, entry->value);
+                break;
+            case VideoLog::Kind::RegisterWrite:
+                line_writes[line_write_count++]
+                    = { entry->x, static_cast<uint8_t>(entry->address), entry->old_value, entry->value };
+                break;
+            case VideoLog::Kind::Line:
+                renderer.draw_line(entry->address,
+                    entry->window ? std::optional<uint8_t>(entry->window_line) : std::nullopt,
+                    { line_writes.data(), line_write_count }, output);
+                line_write_count = 0;
+                break;
+            }
+            log.pop();
+        }
+    }
+}
+
+void RenderThread::apply_write(uint16_t address, uint8_t value)
+{
+    if (is_in_between(address, 0x8000, 0x9fff)) {
+        vram[address - 0x8000] = value;
+        if (address < 0x9800) {
+            uint16_t row = (address - 0x8000) >> 1;
+            stale_tile_rows[row >> 6] |= uint64_t(1) << (row & 0x3f);
+        }
+    } else if (is_in_between(address, 0xfe00, 0xfe9f)) {
+        oam[address - 0xfe00] = value;
+        ++oam_writes;
+    } else if (is_in_between(address, Memory::LCD_REGISTERS_ADDR, Memory::LCD_REGISTERS_END)) {
+        lcd_registers[address - Memory::LCD_REGISTERS_ADDR] = value;
+    }
+}
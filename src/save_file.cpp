@@ -0,0 +1,204 @@
+#include "save_file.hpp"
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+/**
+ * @brief Background thread flushing the dirty pages of all the open save files, each one at its own interval.
+ *
+ * A single thread serves every instance, so that running many games does not start one thread per save file. It
+ * runs while at least one save file is registered.
+ */
+class Flusher {
+public:
+    /**
+     * @brief Gives the flusher of the process.
+     *
+     * @return The flusher. It is never destroyed, as save files can outlive the static objects.
+     */
+    static Flusher& instance()
+    {
+        static Flusher* flusher = new Flusher();
+        return *flusher;
+    }
+
+    /**
+     * @brief Registers a save file, starting the thread if it is the first one.
+     *
+     * @param file Save file to flush.
+     * @param interval Delay between two flushes of the file. Zero disables them.
+     */
+    void add(SaveFile* file, std::chrono::milliseconds interval)
+    {
+        {
+            std::lock_guard lock(mutex);
+            files.push_back({ file, interval, Clock::now() + interval });
+            if (!thread.joinable())
+                thread = std::thread(&Flusher::run, this, generation);
+        }
+        wakeup.notify_all();
+    }
+    /**
+     * @brief Unregisters a save file, which the thread does not touch anymore once this returns. The thread stops
+     * with the last file.
+     *
+     * @param file Registered save file.
+     */
+    void remove(SaveFile* file)
+    {
+        std::thread finished;
+        {
+            // The thread flushes with the lock held, the file is not being flushed once the lock is taken.
+            std::lock_guard lock(mutex);
+            std::erase_if(files, [file](const Entry& entry) { return entry.file == file; });
+            if (files.empty()) {
+                ++generation;
+                finished = std::move(thread);
+            }
+        }
+        wakeup.notify_all();
+        if (finished.joinable())
+            finished.join();
+    }
+    /**
+     * @brief Changes the delay between two flushes of a registered save file.
+     *
+     * @param file Registered save file.
+     * @param interval New delay. Zero disables periodic flushing.
+     */
+    void set_interval(SaveFile* file, std::chrono::milliseconds interval)
+    {
+        {
+            std::lock_guard lock(mutex);
+            for (Entry& entry : files) {
+                if (entry.file == file) {
+                    entry.interval = interval;
+                    entry.next_flush = Clock::now() + interval;
+                }
+            }
+        }
+        wakeup.notify_all();
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Registered save file.
+     */
+    struct Entry {
+        SaveFile* file; /**< The save file. */
+        std::chrono::milliseconds interval; /**< Delay between two flushes, zero if disabled. */
+        Clock::time_point next_flush; /**< Time of the next flush. */
+    };
+
+    std::mutex mutex; /**< Protects the members below, held by the thread while flushing. */
+    std::condition_variable wakeup; /**< Wakes the thread up when the files or their intervals change. */
+    std::vector<Entry> files; /**< Registered save files. */
+    std::thread thread; /**< The flusher thread, while files are registered. */
+    uint64_t generation {}; /**< Number of times the thread was stopped, telling a stopped thread to exit. */
+
+    /**
+     * @brief Body of the thread: flushes the files that are due, then sleeps until the next one is.
+     *
+     * @param thread_generation Value of generation when the thread was started, it exits once it changes.
+     */
+    void run(uint64_t thread_generation)
+    {
+        std::unique_lock lock(mutex);
+        while (generation == thread_generation) {
+            Clock::time_point now = Clock::now();
+            Clock::time_point next = Clock::time_point::max();
+            for (Entry& entry : files) {
+                if (entry.interval.count() == 0)
+                    continue;
+                if (entry.next_flush <= now) {
+                    entry.file->flush();
+                    entry.next_flush = now + entry.interval;
+                }
+                next = std::min(next, entry.next_flush);
+            }
+            if (next == Clock::time_point::max())
+                wakeup.wait(lock);
+            else
+                wakeup.wait_until(lock, next);
+        }
+    }
+};
+
+} // namespace
+
+SaveFile::SaveFile(const std::string& path, size_t size, std::chrono::milliseconds flush_interval)
+{
+    fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+        throw std::runtime_error(std::string("Could not open save file: ") + path + " (" + std::strerror(errno) + ")");
+
+    // A larger file (e.g., with the RTC footer another emulator appends) is kept whole, only its first bytes are
+    // mapped. A save the user already has is never shrunk.
+    struct stat st {};
+    if (fstat(fd, &st) != 0 or (static_cast<size_t>(st.st_size) < size and ftruncate(fd, size) != 0)) {
+        close(fd);
+        throw std::runtime_error(
+            std::string("Could not resize save file: ") + path + " (" + std::strerror(errno) + ")");
+    }
+
+    void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        close(fd);
+        throw std::runtime_error(std::string("Could not map save file: ") + path + " (" + std::strerror(errno) + ")");
+    }
+    mapping = static_cast<uint8_t*>(addr);
+    mapping_size = size;
+
+    size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    page_shift = std::countr_zero(page_size);
+    page_count = (size + page_size - 1) >> page_shift;
+    dirty_pages = std::make_unique<std::atomic<bool>[]>(page_count);
+
+    Flusher::instance().add(this, flush_interval);
+}
+
+SaveFile::~SaveFile()
+{
+    Flusher::instance().remove(this);
+    flush();
+    munmap(mapping, mapping_size);
+    close(fd);
+}
+
+void SaveFile::set_flush_interval(std::chrono::milliseconds interval)
+{
+    Flusher::instance().set_interval(this, interval);
+}
+
+void SaveFile::flush()
+{
+    std::lock_guard lock(flush_mutex);
+    size_t page = 0;
+    while (page < page_count) {
+        if (!dirty_pages[page].exchange(false, std::memory_order_relaxed)) {
+            ++page;
+            continue;
+        }
+        // Coalesces consecutive dirty pages into a single msync call.
+        size_t first = page++;
+        while (page < page_count and dirty_pages[page].exchange(false, std::memory_order_relaxed))
+            ++page;
+        size_t offset = first << page_shift;
+        size_t length = std::min(page << page_shift, mapping_size) - offset;
+        msync(mapping + offset, length, MS_SYNC);
+    }
+}
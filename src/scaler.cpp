@@ -0,0 +1,269 @@
+#include "scaler.hpp"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+/**
+ * @brief Scales a row of pixels. The input rows are padded with one pixel on each side, the pixel x being at x + 1.
+ *
+ * Arguments: row above, row, row below, width, pointers to the scale factor output rows.
+ */
+using ScaleRow = void (*)(const uint32_t*, const uint32_t*, const uint32_t*, size_t, uint32_t* const*);
+
+/**
+ * @brief Averages two pixels byte by byte, rounding up like _mm_avg_epu8().
+ */
+uint32_t average(uint32_t a, uint32_t b)
+{
+    return (a | b) - (((a ^ b) >> 1) & 0x7f7f7f7f);
+}
+
+/**
+ * @brief Gives the color of an output pixel following an edge: the neighbor color, or a 3:1 blend of the neighbor
+ * and the pixel colors when smoothing.
+ */
+template <bool smooth>
+uint32_t edge_color(uint32_t neighbor, uint32_t pixel)
+{
+    return smooth ? average(average(neighbor, pixel), neighbor) : neighbor;
+}
+
+template <bool smooth>
+void scale2x_row_scalar(
+    const uint32_t* above, const uint32_t* row, const uint32_t* below, size_t width, uint32_t* const* output)
+{
+    for (size_t x = 0; x < width; ++x) {
+        uint32_t b = above[x + 1], d = row[x], e = row[x + 1], f = row[x + 2], h = below[x + 1];
+        uint32_t e0 = e, e1 = e, e2 = e, e3 = e;
+        if (b != h and d != f) {
+            e0 = d == b ? edge_color<smooth>(d, e) : e;
+            e1 = b == f ? edge_color<smooth>(f, e) : e;
+            e2 = d == h ? edge_color<smooth>(d, e) : e;
+            e3 = h == f ? edge_color<smooth>(f, e) : e;
+        }
+        output[0][x * 2] = e0;
+        output[0][x * 2 + 1] = e1;
+        output[1][x * 2] = e2;
+        output[1][x * 2 + 1] = e3;
+    }
+}
+
+void scale3x_row_scalar(
+    const uint32_t* above, const uint32_t* row, const uint32_t* below, size_t width, uint32_t* const* output)
+{
+    for (size_t x = 0; x < width; ++x) {
+        uint32_t a = above[x], b = above[x + 1], c = above[x + 2];
+        uint32_t d = row[x], e = row[x + 1], f = row[x + 2];
+        uint32_t g = below[x], h = below[x + 1], i = below[x + 2];
+        std::array<uint32_t, 9> out;
+        out.fill(e);
+        if (b != h and d != f) {
+            out[0] = d == b ? d : e;
+            out[1] = (d == b and e != c) or (b == f and e != a) ? b : e;
+            out[2] = b == f ? f : e;
+            out[3] = (d == b and e != g) or (d == h and e != a) ? d : e;
+            out[5] = (b == f and e != i) or (h == f and e != c) ? f : e;
+            out[6] = d == h ? d : e;
+            out[7] = (d == h and e != i) or (h == f and e != g) ? h : e;
+            out[8] = h == f ? f : e;
+        }
+        for (int k = 0; k < 9; ++k)
+            output[k / 3][x * 3 + k % 3] = out[k];
+    }
+}
+
+/**
+ * @brief Scales the pixels left after the vector loop, from x on, with a scalar row function.
+ */
+template <int factor>
+void scale_tail(ScaleRow scale_row, const uint32_t* above, const uint32_t* row, const uint32_t* below, size_t x,
+    size_t width, uint32_t* const* output)
+{
+    if (x == width)
+        return;
+    uint32_t* tail[factor];
+    for (int k = 0; k < factor; ++k)
+        tail[k] = output[k] + x * factor;
+    scale_row(above + x, row + x, below + x, width - x, tail);
+}
+
+#if defined(__x86_64__)
+/**
+ * @brief Picks x where mask is set, y elsewhere.
+ */
+__attribute__((target("sse2"))) inline __m128i select(__m128i mask, __m128i x, __m128i y)
+{
+    return _mm_or_si128(_mm_and_si128(mask, x), _mm_andnot_si128(mask, y));
+}
+
+__attribute__((target("sse2"))) inline __m128i load(const uint32_t* pixels)
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels));
+}
+
+__attribute__((target("sse2"))) inline void store(uint32_t* pixels, __m128i value)
+{
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels), value);
+}
+
+template <bool smooth>
+__attribute__((target("sse2"))) void scale2x_row_sse2(
+    const uint32_t* above, const uint32_t* row, const uint32_t* below, size_t width, uint32_t* const* output)
+{
+    size_t x = 0;
+    for (; x + 4 <= width; x += 4) {
+        __m128i b = load(above + x + 1), d = load(row + x), e = load(row + x + 1), f = load(row + x + 2);
+        __m128i h = load(below + x + 1);
+        __m128i active = _mm_andnot_si128(
+            _mm_or_si128(_mm_cmpeq_epi32(b, h), _mm_cmpeq_epi32(d, f)), _mm_set1_epi32(-1));
+        __m128i left = d, right = f;
+        if (smooth) {
+            left = _mm_avg_epu8(_mm_avg_epu8(d, e), d);
+            right = _mm_avg_epu8(_mm_avg_epu8(f, e), f);
+        }
+        __m128i e0 = select(_mm_and_si128(active, _mm_cmpeq_epi32(d, b)), left, e);
+        __m128i e1 = select(_mm_and_si128(active, _mm_cmpeq_epi32(b, f)), right, e);
+        __m128i e2 = select(_mm_and_si128(active, _mm_cmpeq_epi32(d, h)), left, e);
+        __m128i e3 = select(_mm_and_si128(active, _mm_cmpeq_epi32(h, f)), right, e);
+        store(output[0] + x * 2, _mm_unpacklo_epi32(e0, e1));
+        store(output[0] + x * 2 + 4, _mm_unpackhi_epi32(e0, e1));
+        store(output[1] + x * 2, _mm_unpacklo_epi32(e2, e3));
+        store(output[1] + x * 2 + 4, _mm_unpackhi_epi32(e2, e3));
+    }
+    scale_tail<2>(scale2x_row_scalar<smooth>, above, row, below, x, width, output);
+}
+
+/**
+ * @brief Stores 3 vectors of 4 pixels interleaved: a0 b0 c0 a1 b1 c1...
+ */
+__attribute__((target("sse2"))) inline void store_interleaved3(uint32_t* pixels, __m128i a, __m128i b, __m128i c)
+{
+    __m128 ab_lo = _mm_castsi128_ps(_mm_unpacklo_epi32(a, b)); // a0 b0 a1 b1
+    __m128 ab_hi = _mm_castsi128_ps(_mm_unpackhi_epi32(a, b)); // a2 b2 a3 b3
+    __m128 bc_lo = _mm_castsi128_ps(_mm_unpacklo_epi32(b, c)); // b0 c0 b1 c1
+    __m128 bc_hi = _mm_castsi128_ps(_mm_unpackhi_epi32(b, c)); // b2 c2 b3 c3
+    __m128 ca_lo = _mm_castsi128_ps(_mm_unpacklo_epi32(c, a)); // c0 a0 c1 a1
+    __m128 ca_hi = _mm_castsi128_ps(_mm_unpackhi_epi32(c, a)); // c2 a2 c3 a3
+    store(pixels, _mm_castps_si128(_mm_shuffle_ps(ab_lo, ca_lo, _MM_SHUFFLE(3, 0, 1, 0))));
+    store(pixels + 4, _mm_castps_si128(_mm_shuffle_ps(bc_lo, ab_hi, _MM_SHUFFLE(1, 0, 3, 2))));
+    store(pixels + 8, _mm_castps_si128(_mm_shuffle_ps(ca_hi, bc_hi, _MM_SHUFFLE(3, 2, 3, 0))));
+}
+
+__attribute__((target("sse2"))) void scale3x_row_sse2(
+    const uint32_t* above, const uint32_t* row, const uint32_t* below, size_t width, uint32_t* const* output)
+{
+    size_t x = 0;
+    __m128i ones = _mm_set1_epi32(-1);
+    for (; x + 4 <= width; x += 4) {
+        __m128i a = load(above + x), b = load(above + x + 1), c = load(above + x + 2);
+        __m128i d = load(row + x), e = load(row + x + 1), f = load(row + x + 2);
+        __m128i g = load(below + x), h = load(below + x + 1), i = load(below + x + 2);
+        __m128i active = _mm_andnot_si128(_mm_or_si128(_mm_cmpeq_epi32(b, h), _mm_cmpeq_epi32(d, f)), ones);
+        __m128i db = _mm_and_si128(active, _mm_cmpeq_epi32(d, b));
+        __m128i bf = _mm_and_si128(active, _mm_cmpeq_epi32(b, f));
+        __m128i dh = _mm_and_si128(active, _mm_cmpeq_epi32(d, h));
+        __m128i hf = _mm_and_si128(active, _mm_cmpeq_epi32(h, f));
+        __m128i not_a = _mm_andnot_si128(_mm_cmpeq_epi32(e, a), ones);
+        __m128i not_c = _mm_andnot_si128(_mm_cmpeq_epi32(e, c), ones);
+        __m128i not_g = _mm_andnot_si128(_mm_cmpeq_epi32(e, g), ones);
+        __m128i not_i = _mm_andnot_si128(_mm_cmpeq_epi32(e, i), ones);
+
+        __m128i e0 = select(db, d, e);
+        __m128i e1 = select(_mm_or_si128(_mm_and_si128(db, not_c), _mm_and_si128(bf, not_a)), b, e);
+        __m128i e2 = select(bf, f, e);
+        __m128i e3 = select(_mm_or_si128(_mm_and_si128(db, not_g), _mm_and_si128(dh, not_a)), d, e);
+        __m128i e5 = select(_mm_or_si128(_mm_and_si128(bf, not_i), _mm_and_si128(hf, not_c)), f, e);
+        __m128i e6 = select(dh, d, e);
+        __m128i e7 = select(_mm_or_si128(_mm_and_si128(dh, not_i), _mm_and_si128(hf, not_g)), h, e);
+        __m128i e8 = select(hf, f, e);
+        store_interleaved3(output[0] + x * 3, e0, e1, e2);
+        store_interleaved3(output[1] + x * 3, e3, e, e5);
+        store_interleaved3(output[2] + x * 3, e6, e7, e8);
+    }
+    scale_tail<3>(scale3x_row_scalar, above, row, below, x, width, output);
+}
+#endif
+
+/**
+ * @brief Picks the fastest row scaling supported by the running CPU for a filter.
+ */
+ScaleRow select_scale_row(ScaleFilter filter)
+{
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("sse2")) {
+        switch (filter) {
+        case ScaleFilter::Scale2x:
+            return scale2x_row_sse2<false>;
+        case ScaleFilter::Scale3x:
+            return scale3x_row_sse2;
+        case ScaleFilter::Smooth2x:
+            return scale2x_row_sse2<true>;
+        default:
+            return nullptr;
+        }
+    }
+#endif
+    switch (filter) {
+    case ScaleFilter::Scale2x:
+        return scale2x_row_scalar<false>;
+    case ScaleFilter::Scale3x:
+        return scale3x_row_scalar;
+    case ScaleFilter::Smooth2x:
+        return scale2x_row_scalar<true>;
+    default:
+        return nullptr;
+    }
+}
+
+/**
+ * @brief Copies a row of pixels with one more pixel on each side, copying the edge pixels.
+ */
+void pad_row(const uint8_t* pixels, size_t width, uint32_t* padded)
+{
+    std::memcpy(padded + 1, pixels, width * 4);
+    padded[0] = padded[1];
+    padded[width + 1] = padded[width];
+}
+
+} // namespace
+
+void scale_image(const uint8_t* pixels, size_t width, size_t height, size_t stride, ScaleFilter filter,
+    uint8_t* output, size_t output_stride)
+{
+    static const std::array<ScaleRow, 4> scale_rows = { nullptr, select_scale_row(ScaleFilter::Scale2x),
+        select_scale_row(ScaleFilter::Scale3x), select_scale_row(ScaleFilter::Smooth2x) };
+    ScaleRow scale_row = scale_rows[static_cast<size_t>(filter)];
+    if (!scale_row) {
+        for (size_t y = 0; y < height; ++y)
+            std::memcpy(output + y * output_stride, pixels + y * stride, width * 4);
+        return;
+    }
+    if (width == 0 or height == 0)
+        return;
+
+    // Three padded rows (above, current and below) are kept, each one padded once as the scaling moves down.
+    int factor = scale_factor(filter);
+    std::vector<uint32_t> padded((width + 2) * 3);
+    uint32_t* rows[3] = { padded.data(), padded.data() + width + 2, padded.data() + (width + 2) * 2 };
+    pad_row(pixels, width, rows[1]);
+    std::copy_n(rows[1], width + 2, rows[0]);
+    for (size_t y = 0; y < height; ++y) {
+        if (y + 1 < height)
+            pad_row(pixels + (y + 1) * stride, width, rows[2]);
+        else
+            std::copy_n(rows[1], width + 2, rows[2]);
+
+        uint32_t* output_rows[3];
+        for (int k = 0; k < factor; ++k)
+            output_rows[k] = reinterpret_cast<uint32_t*>(output + (y * factor + k) * output_stride);
+        scale_row(rows[0], rows[1], rows[2], width, output_rows);
+        std::rotate(rows, rows + 1, rows + 3);
+    }
+}
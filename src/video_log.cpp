@@ -0,0 +1,38 @@
+#include "video_log.hpp"
+
+void VideoLog::wait_until_handled()
+{
+    uint32_t end = tail.load(std::memory_order_relaxed);
+    notify();
+    for (uint32_t index = head.load(std::memory_order_acquire); index != end;
+         index = head.load(std::memory_order_acquire))
+        head.wait(index, std::memory_order_acquire);
+}
+
+void VideoLog::close()
+{
+    closed.store(true, std::memory_order_release);
+    notify();
+}
+
+bool VideoLog::wait_for_entries()
+{
+    while (true) {
+        // Loaded first, so that a wake up coming after the checks is not missed.
+        uint32_t wakeup = wakeups.load(std::memory_order_acquire);
+        if (head.load(std::memory_order_relaxed) != tail.load(std::memory_order_acquire))
+            return true;
+        if (closed.load(std::memory_order_acquire))
+            return false;
+        wakeups.wait(wakeup, std::memory_order_acquire);
+    }
+}
+
+void VideoLog::pop()
+{
+    uint32_t index = head.load(std::memory_order_relaxed) + 1;
+    head.store(index, std::memory_order_release);
+    // The emulation thread only waits for the log to be empty.
+    if (index == tail.load(std::memory_order_acquire))
+        head.notify_all();
+}
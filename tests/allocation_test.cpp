@@ -0,0 +1,190 @@
+#include "gameboy.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+
+/**
+ * @brief Checks that running frames never allocates once an instance is warmed up, whatever the renderer and with
+ * the observations enabled.
+ *
+ * The global operator new is replaced by a counting one. Each ROM runs a few frames to warm up (loading, first
+ * decoding of the tiles...), then the allocations made by all the threads are counted over the next frames, and
+ * must be 0. The ROMs are copied to a temporary directory first, so that their save files are not written next to
+ * the originals.
+ *
+ * Usage: allocation_test <roms directory>
+ */
+
+static std::atomic<bool> counting { false }; /**< true while the allocations are counted. */
+static std::atomic<uint64_t> allocations {}; /**< Allocations counted. */
+
+static void* allocate(size_t size, size_t alignment = 0)
+{
+    if (counting.load(std::memory_order_relaxed))
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    if (size == 0)
+        size = 1;
+    if (alignment == 0)
+        return std::malloc(size);
+    return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+void* operator new(size_t size)
+{
+    if (void* pointer = allocate(size))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    if (void* pointer = allocate(size, static_cast<size_t>(alignment)))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocate(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocate(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* pointer) noexcept { std::free(pointer); }
+void operator delete[](void* pointer) noexcept { std::free(pointer); }
+void operator delete(void* pointer, size_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { std::free(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { std::free(pointer); }
+
+namespace {
+
+constexpr int WARM_UP_FRAMES = 60; /**< Frames run before counting. */
+
+/**
+ * @brief ROM run by the test.
+ */
+struct Rom {
+    const char* path; /**< Path in the roms directory. */
+    int frames; /**< Frames run while counting. */
+};
+
+const Rom roms[] = {
+    { "tetris.gb", 600 }, // The demo, where the objects move, starts after about 450 frames.
+    { "test/cpu_instrs/cpu_instrs.gb", 120 },
+    { "test/instr_timing/instr_timing.gb", 120 },
+    { "test/mem_timing/mem_timing.gb", 120 },
+    { "test/mem_timing-2/mem_timing.gb", 120 },
+    { "test/halt_bug.gb", 120 },
+    { "test/interrupt_time/interrupt_time.gb", 120 },
+    { "test/oam_bug/oam_bug.gb", 120 },
+    { "test/dmg_sound/dmg_sound.gb", 120 },
+};
+
+/**
+ * @brief Emulator settings the ROMs are run with.
+ */
+enum class Setup {
+    Scanline, /**< Scanline renderer. */
+    PixelFifo, /**< Pixel FIFO renderer. */
+    Observations, /**< Scanline renderer, with the observations enabled. */
+};
+
+const char* setup_name(Setup setup)
+{
+    switch (setup) {
+    case Setup::Scanline:
+        return "scanline";
+    case Setup::PixelFifo:
+        return "pixel FIFO";
+    default:
+        return "observations";
+    }
+}
+
+/**
+ * @brief Runs a ROM and counts the allocations made after the warm-up.
+ *
+ * @param path Path of the ROM.
+ * @param frames Frames run while counting.
+ * @param setup Emulator settings.
+ * @return The number of allocations.
+ */
+uint64_t count_allocations(const std::string& path, int frames, Setup setup)
+{
+    auto gameboy = std::make_unique<GameBoy>();
+    gameboy->load_rom(path);
+    gameboy->set_renderer(setup == Setup::PixelFifo ? PPU::Renderer::PixelFifo : PPU::Renderer::Scanline);
+    if (setup == Setup::Observations)
+        gameboy->enable_observations({});
+    for (int frame = 0; frame < WARM_UP_FRAMES; ++frame)
+        gameboy->run_frame();
+
+    allocations.store(0, std::memory_order_relaxed);
+    counting.store(true, std::memory_order_relaxed);
+    for (int frame = 0; frame < frames; ++frame)
+        gameboy->run_frame();
+    counting.store(false, std::memory_order_relaxed);
+    return allocations.load(std::memory_order_relaxed);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc != 2) {
+        std::cout << "Usage: " << argv[0] << " <roms directory>" << std::endl;
+        return 2;
+    }
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "gameboy_allocation_test";
+    std::filesystem::create_directories(directory);
+
+    int failures = 0;
+    for (const Rom& rom : roms) {
+        std::filesystem::path path = directory / std::filesystem::path(rom.path).filename();
+        std::filesystem::copy_file(
+            std::filesystem::path(argv[1]) / rom.path, path, std::filesystem::copy_options::overwrite_existing);
+        for (Setup setup : { Setup::Scanline, Setup::PixelFifo, Setup::Observations }) {
+            uint64_t count = count_allocations(path, rom.frames, setup);
+            std::cout << (count == 0 ? "ok    " : "FAIL  ") << rom.path << " (" << setup_name(setup) << "): " << count
+                      << " allocations in " << rom.frames << " frames" << std::endl;
+            if (count != 0)
+                ++failures;
+        }
+    }
+    std::filesystem::remove_all(directory);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,115 @@
+#include "gameboy.hpp"
+#include "video_log.hpp"
+#include <array>
+#include <cstddef>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+
+/**
+ * @brief Checks the memory used by an instance against budgets set from the data it has to hold.
+ *
+ * The object budget is the machine state (VRAM, WRAM, OAM, I/O registers, HRAM, IE) plus the fast memory map and a
+ * fixed allowance for the bookkeeping of the components. The heap budgets add up the buffers each setup needs. They
+ * follow what the emulated hardware and the features require, not what the tree happens to use: a change that does
+ * not fit makes room (e.g., by moving state out of the object) rather than raising them.
+ *
+ * Usage: footprint_test <roms directory>
+ */
+
+namespace {
+
+constexpr int FRAMES = 60; /**< Frames run before measuring, the caches of the drawing are then allocated. */
+
+constexpr size_t MACHINE_STATE = 0x2000 + 0x2000 + 0xa0 + 0x80 + 0x7f + 1; /**< VRAM, WRAM, OAM, I/O, HRAM, IE. */
+constexpr size_t MEMORY_MAP = 2 * 0x100 * sizeof(void*); /**< Read and write pointers of each page. */
+/**
+ * Registers and counters of the CPU, the PPU and the scheduler, the LCD register writes of a line and the objects of
+ * each line.
+ */
+constexpr size_t BOOKKEEPING = 6 * 1024;
+constexpr size_t OBJECT_BUDGET = MACHINE_STATE + MEMORY_MAP + BOOKKEEPING; /**< Size of the GameBoy object. */
+
+constexpr size_t FRAME = PPU::SCREEN_WIDTH * PPU::SCREEN_HEIGHT; /**< A frame of one byte per pixel. */
+constexpr size_t TILE_CACHE = Memory::TILE_ROWS * 8; /**< Tile data decoded to one byte per pixel. */
+/**
+ * Background of each line: its color codes, the two tile map rows it was drawn from and their registers and tiles.
+ */
+constexpr size_t BACKGROUND_CACHE = PPU::SCREEN_HEIGHT * (PPU::SCREEN_WIDTH + 2 * 32 + 32);
+constexpr size_t DRAWING = TILE_CACHE + BACKGROUND_CACHE; /**< Caches of a drawing LineRenderer. */
+/**
+ * Render thread: its log, its copy of the video memory and the object lists of its own LineRenderer, which draws
+ * instead of the PPU one.
+ */
+constexpr size_t RENDER_THREAD = VideoLog::CAPACITY * sizeof(VideoLog::Entry) + 0x2000 + 0xa0 + 4 * 1024;
+/**
+ * Observations with the default settings: the two last frames, the ring of 4 observations of 84x84 kept twice and
+ * the taps.
+ */
+constexpr size_t OBSERVATIONS = 2 * FRAME + 2 * 4 * 84 * 84 + 4 * 1024;
+
+/**
+ * @brief Emulator settings measured, with the heap they are allowed.
+ */
+struct Setup {
+    const char* name; /**< Name printed. */
+    bool embedder_output; /**< true to draw into a buffer of the test instead of the internal framebuffer. */
+    bool render_thread; /**< true to draw on a render thread. */
+    bool observations; /**< true to enable the observations, with their default settings. */
+    bool render_skip; /**< true to skip the drawing once the frames ran. */
+    size_t heap_budget; /**< Budget of the memory owned outside of the object. */
+};
+
+const Setup setups[] = {
+    { "scanline", false, false, false, false, FRAME + DRAWING },
+    { "embedder output", true, false, false, false, DRAWING },
+    { "render thread", false, true, false, false, FRAME + DRAWING + RENDER_THREAD },
+    { "observations", false, false, true, false, FRAME + DRAWING + OBSERVATIONS },
+    { "render skip", false, false, false, true, FRAME },
+};
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc != 2) {
+        std::cout << "Usage: " << argv[0] << " <roms directory>" << std::endl;
+        return 2;
+    }
+    // Tetris has no battery, no save file is written next to the ROM.
+    std::string path = (std::filesystem::path(argv[1]) / "tetris.gb").string();
+
+    int failures = 0;
+    bool object_within = sizeof(GameBoy) <= OBJECT_BUDGET;
+    std::cout << (object_within ? "ok    " : "FAIL  ") << "object: " << sizeof(GameBoy) << " bytes (budget "
+              << OBJECT_BUDGET << ", machine state " << MACHINE_STATE << ")" << std::endl;
+    if (!object_within)
+        ++failures;
+
+    std::array<uint8_t, FRAME> pixels;
+    for (const Setup& setup : setups) {
+        auto gameboy = std::make_unique<GameBoy>();
+        gameboy->load_rom(path);
+        if (setup.embedder_output)
+            gameboy->set_frame_output(pixels.data(), PixelFormat::Shade2, PPU::SCREEN_WIDTH);
+        gameboy->set_render_thread(setup.render_thread);
+        if (setup.observations)
+            gameboy->enable_observations({});
+        for (int frame = 0; frame < FRAMES; ++frame)
+            gameboy->run_frame();
+        if (setup.render_skip) {
+            gameboy->set_render_skip(true);
+            for (int frame = 0; frame < 2; ++frame)
+                gameboy->run_frame();
+        }
+
+        size_t heap = gameboy->footprint().heap_bytes;
+        bool within = heap <= setup.heap_budget;
+        std::cout << (within ? "ok    " : "FAIL  ") << setup.name << ": " << heap << " heap bytes (budget "
+                  << setup.heap_budget << ")" << std::endl;
+        if (!within)
+            ++failures;
+    }
+    return failures == 0 ? 0 : 1;
+}